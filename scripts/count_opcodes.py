@@ -2,35 +2,21 @@ import re
 import os
 
 def count_opcodes():
-    cpu_cpp_path = os.path.join('src', 'core', 'cpu.cpp')
+    opcodes_def_path = os.path.join('src', 'core', 'cpu_opcodes.def')
     
-    if not os.path.exists(cpu_cpp_path):
-        print(f"Error: Could not find {cpu_cpp_path}")
+    if not os.path.exists(opcodes_def_path):
+        print(f"Error: Could not find {opcodes_def_path}")
         return
 
     try:
-        with open(cpu_cpp_path, 'r') as f:
+        with open(opcodes_def_path, 'r') as f:
             content = f.read()
             
-        # Find the init_instructions function block to ensure we only count there
-        # This is a simple extraction, looking for the function body
-        start_marker = "void CPU::init_instructions() {"
-        end_marker = "}"
-        
-        start_idx = content.find(start_marker)
-        if start_idx == -1:
-            print("Error: Could not find init_instructions() in cpu.cpp")
-            return
-            
-        # Simplistic finding of the end of the function (assuming consistent indentation/structure or just counting braces)
-        # But scanning line by line inside the function is safer regarding the pattern.
-        
-        # We will just scan the whole file for the specific assignment pattern 
-        # instructions[0xXX] = ...
-        # This is strictly for the assignments in init_instructions.
-        
-        pattern = re.compile(r'instructions\[0x[0-9A-Fa-f]{2}\]\s*=\s*\{')
-        matches = pattern.findall(content)
+        # The opcode table is an X-macro list, one entry per opcode:
+        # CPU_OPCODE(0xXX, "MNEMONIC", HANDLER, LENGTH, CYCLES)
+        # Entries still pointing at the XXX handler are unimplemented.
+        pattern = re.compile(r'^CPU_OPCODE\(0x[0-9A-Fa-f]{2},\s*"[^"]*",\s*(\w+),', re.MULTILINE)
+        matches = [handler for handler in pattern.findall(content) if handler != 'XXX']
         
         count = len(matches)
         total = 256
@@ -0,0 +1,59 @@
+#include "block_cache.h"
+#include <cstring>
+
+BlockCache::Block& BlockCache::allocate(uint16_t pc, uint16_t bank) {
+    // Slots are only allocated once the cache is actually used
+    if (slots.empty()) {
+        slots.resize(NUM_SLOTS);
+    }
+
+    Block& block = slots[slot_index(pc, bank)];
+    block.key = make_key(pc, bank);
+    block.end = pc;
+    block.count = 0;
+    return block;
+}
+
+void BlockCache::mark_code(const Block& block) {
+    uint16_t start = block.key & 0xFFFF;
+    if (start >= 0x8000) {
+        set_code_bits(start, block.end, true);
+    }
+}
+
+void BlockCache::invalidate(uint16_t address) {
+    // First pass - drop every RAM block containing the address and clear its code bits
+    for (Block& block : slots) {
+        if (block.key == INVALID_KEY) continue;
+
+        uint16_t start = block.key & 0xFFFF;
+        if (start >= 0x8000 && address >= start && address < block.end) {
+            set_code_bits(start, block.end, false);
+            block.key = INVALID_KEY;
+        }
+    }
+
+    // Second pass - blocks that overlap the dropped ones may have shared some of the cleared bits
+    for (const Block& block : slots) {
+        if (block.key != INVALID_KEY) {
+            mark_code(block);
+        }
+    }
+}
+
+void BlockCache::clear() {
+    for (Block& block : slots) {
+        block.key = INVALID_KEY;
+    }
+    memset(code_bitmap, 0, sizeof(code_bitmap));
+}
+
+void BlockCache::set_code_bits(uint16_t start, uint16_t end, bool value) {
+    for (uint32_t address = start; address < end; address++) {
+        if (value) {
+            code_bitmap[address >> 3] |= (1 << (address & 0x07));
+        } else {
+            code_bitmap[address >> 3] &= ~(1 << (address & 0x07));
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class CPU;
+
+/**
+ * @brief Cache of pre-decoded SM83 basic blocks.
+ * 
+ * A block is a straight-line run of instructions starting at a given PC, decoded once into opcode + operand bytes so
+ * they don't have to be re-fetched through the MMU every time a hot loop comes around. Blocks are keyed by PC plus
+ * the ROM bank currently mapped at that PC, so MBC bank switches select a different set of blocks instead of
+ * flushing the cache.
+ * 
+ * Only code in ROM ($0000-$7FFF), WRAM ($C000-$DFFF) and HRAM ($FF80-$FFFE) is cached. Code in RAM can be rewritten
+ * at any time (e.g. the OAM DMA routine games copy into HRAM), so every RAM byte covered by a cached block is tracked
+ * in a bitmap and the MMU invalidates the affected blocks when one of those bytes is written.
+ */
+class BlockCache {
+    public:
+        // Longest block decoded in one go
+        static const int MAX_BLOCK_INSTRUCTIONS = 16;
+
+        // Number of direct-mapped slots (must be a power of two)
+        static const int NUM_SLOTS = 2048;
+
+        // Host code compiled from a block by the JIT, returning the cycles it took
+        typedef uint32_t (*NativeCode)(CPU* cpu);
+
+        struct DecodedInstruction {
+            uint8_t opcode;
+            uint8_t operands[2];
+            uint8_t length;
+        };
+
+        struct Block {
+            uint32_t key = INVALID_KEY;     // (bank << 16) | start PC
+            uint16_t end = 0;               // Address one past the last instruction
+            uint8_t count = 0;
+            DecodedInstruction instructions[MAX_BLOCK_INSTRUCTIONS];
+
+            // Times the block has run while interpreted, and its compiled code once the JIT has picked it up
+            uint32_t run_count = 0;
+            NativeCode native = nullptr;
+        };
+
+        // Returns true if code at this address may be cached at all
+        static bool is_cacheable(uint16_t address) {
+            return address <= 0x7FFF || (address >= 0xC000 && address <= 0xDFFF) || (address >= 0xFF80 && address <= 0xFFFE);
+        }
+
+        // Find a previously decoded block, or nullptr on a miss
+        Block* lookup(uint16_t pc, uint16_t bank) {
+            if (slots.empty()) return nullptr;
+
+            Block& block = slots[slot_index(pc, bank)];
+            return (block.key == make_key(pc, bank)) ? &block : nullptr;
+        }
+
+        // Get the slot a new block for pc/bank should be decoded into (evicting whatever was there)
+        Block& allocate(uint16_t pc, uint16_t bank);
+
+        // Record that a RAM-resident block has been decoded, so writes to its bytes invalidate it
+        void mark_code(const Block& block);
+
+        // True if a write to this address could modify cached code
+        bool is_code(uint16_t address) const {
+            return (code_bitmap[address >> 3] >> (address & 0x07)) & 0x01;
+        }
+
+        // Drop every block containing this (RAM) address
+        void invalidate(uint16_t address);
+
+        // Drop every block
+        void clear();
+    private:
+        friend class JIT;
+
+        static const uint32_t INVALID_KEY = 0xFFFFFFFF;
+
+        std::vector<Block> slots;
+
+        // One bit per address in the 64 KB address space, set for RAM bytes that belong to a cached block
+        uint8_t code_bitmap[0x10000 / 8] = {};
+
+        static uint32_t make_key(uint16_t pc, uint16_t bank) {
+            return (static_cast<uint32_t>(bank) << 16) | pc;
+        }
+
+        static uint32_t slot_index(uint16_t pc, uint16_t bank) {
+            return (pc ^ (bank * 0x9E5)) & (NUM_SLOTS - 1);
+        }
+
+        void set_code_bits(uint16_t start, uint16_t end, bool value);
+};
@@ -0,0 +1,216 @@
+#include "compositor.h"
+
+// SSE2 is part of x86-64, AVX2 is checked for at runtime - neither needs extra compiler flags
+#if defined(__x86_64__) || defined(_M_X64)
+#define GAMEBYTE_COMPOSITOR_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GAMEBYTE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GAMEBYTE_TARGET_AVX2
+#endif
+
+namespace {
+    // Shade of every composed index - background 0-3, sprites OBJ_OBP0/OBJ_OBP1 + 1-3, the rest unused
+    void build_shades(uint8_t bgp, uint8_t obp0, uint8_t obp1, uint8_t shades[16]) {
+        for (int color_id = 0; color_id < 4; color_id++) {
+            shades[color_id] = (bgp >> (color_id * 2)) & 0x03;
+            shades[ScanlineCompositor::OBJ_OBP0 + color_id] = (obp0 >> (color_id * 2)) & 0x03;
+            shades[ScanlineCompositor::OBJ_OBP1 + color_id] = (obp1 >> (color_id * 2)) & 0x03;
+            shades[12 + color_id] = 0;
+        }
+    }
+
+    void compose_scalar(const ScanlineCompositor::Layers& layers, const uint8_t shades[16], uint8_t* out) {
+        for (int px = 0; px < ScanlineCompositor::WIDTH; px++) {
+            uint8_t bg = layers.bg[px];
+            uint8_t front = layers.obj_front[px];
+
+            // Background color 0 lets every sprite through, any other only the ones in front of it
+            uint8_t index = (bg == 0) ? layers.obj[px] : (front ? front : bg);
+            out[px] = shades[index];
+        }
+    }
+
+    void expand_scalar(const uint8_t* shades, int count, const uint32_t palette[4], uint32_t* out) {
+        for (int i = 0; i < count; i++) {
+            out[i] = palette[shades[i] & 0x03];
+        }
+    }
+
+#ifdef GAMEBYTE_COMPOSITOR_SIMD
+    bool host_has_avx2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        // The OS has to save the YMM registers too
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x06) != 0x06) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    // compose_scalar()'s selection for 16 pixels at once
+    inline __m128i select_sse2(__m128i bg, __m128i obj, __m128i front) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i bg_zero = _mm_cmpeq_epi8(bg, zero);
+        __m128i no_front = _mm_cmpeq_epi8(front, zero);
+        __m128i over_bg = _mm_or_si128(_mm_and_si128(no_front, bg), _mm_andnot_si128(no_front, front));
+        return _mm_or_si128(_mm_and_si128(bg_zero, obj), _mm_andnot_si128(bg_zero, over_bg));
+    }
+
+    void compose_sse2(const ScanlineCompositor::Layers& layers, const uint8_t shades[16], uint8_t* out) {
+        for (int px = 0; px < ScanlineCompositor::WIDTH; px += 16) {
+            __m128i bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layers.bg + px));
+            __m128i obj = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layers.obj + px));
+            __m128i front = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layers.obj_front + px));
+            __m128i index = select_sse2(bg, obj, front);
+
+            // SSE2 has no byte shuffle, so the 12 indices in use are looked up by comparing against each
+            __m128i shade = _mm_setzero_si128();
+            for (int i = 0; i < 12; i++) {
+                __m128i match = _mm_cmpeq_epi8(index, _mm_set1_epi8(static_cast<char>(i)));
+                shade = _mm_or_si128(shade, _mm_and_si128(match, _mm_set1_epi8(static_cast<char>(shades[i]))));
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + px), shade);
+        }
+    }
+
+    void expand_sse2(const uint8_t* shades, int count, const uint32_t palette[4], uint32_t* out) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i colors[4] = { _mm_set1_epi32(static_cast<int>(palette[0])), _mm_set1_epi32(static_cast<int>(palette[1])),
+                                    _mm_set1_epi32(static_cast<int>(palette[2])), _mm_set1_epi32(static_cast<int>(palette[3])) };
+
+        int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shades + i));
+            __m128i words_low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i words_high = _mm_unpackhi_epi8(bytes, zero);
+            __m128i indices[4] = { _mm_unpacklo_epi16(words_low, zero), _mm_unpackhi_epi16(words_low, zero),
+                                   _mm_unpacklo_epi16(words_high, zero), _mm_unpackhi_epi16(words_high, zero) };
+
+            for (int j = 0; j < 4; j++) {
+                // Pick by shade bit 0, then by bit 1 - each bit shifted into the sign and spread over the lane
+                __m128i bit0 = _mm_srai_epi32(_mm_slli_epi32(indices[j], 31), 31);
+                __m128i bit1 = _mm_srai_epi32(_mm_slli_epi32(indices[j], 30), 31);
+                __m128i light = _mm_or_si128(_mm_and_si128(bit0, colors[1]), _mm_andnot_si128(bit0, colors[0]));
+                __m128i dark = _mm_or_si128(_mm_and_si128(bit0, colors[3]), _mm_andnot_si128(bit0, colors[2]));
+                __m128i pixels = _mm_or_si128(_mm_and_si128(bit1, dark), _mm_andnot_si128(bit1, light));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + j * 4), pixels);
+            }
+        }
+
+        expand_scalar(shades + i, count - i, palette, out + i);
+    }
+
+    GAMEBYTE_TARGET_AVX2 void compose_avx2(const ScanlineCompositor::Layers& layers, const uint8_t shades[16], uint8_t* out) {
+        const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(shades)));
+        const __m256i zero = _mm256_setzero_si256();
+
+        for (int px = 0; px < ScanlineCompositor::WIDTH; px += 32) {
+            __m256i bg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(layers.bg + px));
+            __m256i obj = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(layers.obj + px));
+            __m256i front = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(layers.obj_front + px));
+
+            __m256i bg_zero = _mm256_cmpeq_epi8(bg, zero);
+            __m256i no_front = _mm256_cmpeq_epi8(front, zero);
+            __m256i over_bg = _mm256_blendv_epi8(front, bg, no_front);
+            __m256i index = _mm256_blendv_epi8(over_bg, obj, bg_zero);
+
+            // Indices are below 16, so one shuffle looks up all 32 shades
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + px), _mm256_shuffle_epi8(table, index));
+        }
+    }
+
+    GAMEBYTE_TARGET_AVX2 void expand_avx2(const uint8_t* shades, int count, const uint32_t palette[4], uint32_t* out) {
+        // Shades only use the low 2 bits of the 3-bit permute index, so the palette is repeated
+        const __m256i colors = _mm256_setr_epi32(static_cast<int>(palette[0]), static_cast<int>(palette[1]),
+                                                 static_cast<int>(palette[2]), static_cast<int>(palette[3]),
+                                                 static_cast<int>(palette[0]), static_cast<int>(palette[1]),
+                                                 static_cast<int>(palette[2]), static_cast<int>(palette[3]));
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(shades + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permutevar8x32_epi32(colors, indices));
+        }
+
+        expand_scalar(shades + i, count - i, palette, out + i);
+    }
+#endif
+}
+
+ScanlineCompositor::Path ScanlineCompositor::detect_path() {
+    if (is_path_supported(PATH_AVX2)) return PATH_AVX2;
+    if (is_path_supported(PATH_SSE2)) return PATH_SSE2;
+    return PATH_SCALAR;
+}
+
+bool ScanlineCompositor::is_path_supported(Path path) {
+    switch (path) {
+        case PATH_SCALAR:
+            return true;
+#ifdef GAMEBYTE_COMPOSITOR_SIMD
+        case PATH_SSE2:
+            return true;
+        case PATH_AVX2: {
+            static const bool supported = host_has_avx2();
+            return supported;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* ScanlineCompositor::get_path_name(Path path) {
+    switch (path) {
+        case PATH_SSE2: return "SSE2";
+        case PATH_AVX2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
+bool ScanlineCompositor::set_path(Path path) {
+    if (!is_path_supported(path)) return false;
+
+    this->path = path;
+    return true;
+}
+
+void ScanlineCompositor::compose(const Layers& layers, uint8_t bgp, uint8_t obp0, uint8_t obp1, uint8_t* out) const {
+    uint8_t shades[16];
+    build_shades(bgp, obp0, obp1, shades);
+
+    switch (path) {
+#ifdef GAMEBYTE_COMPOSITOR_SIMD
+        case PATH_SSE2: compose_sse2(layers, shades, out); break;
+        case PATH_AVX2: compose_avx2(layers, shades, out); break;
+#endif
+        default: compose_scalar(layers, shades, out); break;
+    }
+}
+
+void ScanlineCompositor::expand(const uint8_t* shades, int count, const uint32_t palette[4], uint32_t* out) const {
+    switch (path) {
+#ifdef GAMEBYTE_COMPOSITOR_SIMD
+        case PATH_SSE2: expand_sse2(shades, count, palette, out); break;
+        case PATH_AVX2: expand_avx2(shades, count, palette, out); break;
+#endif
+        default: expand_scalar(shades, count, palette, out); break;
+    }
+}
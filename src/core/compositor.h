@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Turns one scanline's background/window and sprite color indices into DMG shades, and shades into host pixels.
+ *
+ * The PPU resolves which tile and sprite pixels land on a line, the compositor does the per-pixel rest for all 160
+ * pixels at once: sprite-over-background priority and palette mapping through BGP/OBP0/OBP1, down to a shade (0-3) per
+ * pixel. Turning a frame of shades into 32-bit pixels is left to whoever presents it, through expand() and a palette of
+ * its choosing. On x86-64 hosts both run as SSE2 or AVX2 code, picked at runtime from what the CPU supports, with a
+ * portable scalar path everywhere else. Every path produces exactly the same pixels.
+ */
+class ScanlineCompositor {
+    public:
+        static const int WIDTH = 160;
+
+        enum Path : uint8_t {
+            PATH_SCALAR,
+            PATH_SSE2,
+            PATH_AVX2
+        };
+
+        // Sprite pixels are stored as palette base + color index (1-3), 0 where no sprite covers the pixel
+        static const uint8_t OBJ_OBP0 = 4;
+        static const uint8_t OBJ_OBP1 = 8;
+
+        // Color indices of a line, by layer
+        struct Layers {
+            uint8_t bg[WIDTH];          // Background/window, 0-3
+            uint8_t obj[WIDTH];         // Opaque pixel of the highest priority sprite here
+            uint8_t obj_front[WIDTH];   // Same, or 0 if that sprite is behind the background
+        };
+
+        // ARGB8888 palettes for expand(), shade 0 (lightest) first
+        static constexpr uint32_t PALETTE_GRAYSCALE[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+        static constexpr uint32_t PALETTE_DMG_GREEN[4] = { 0xFF9BBC0F, 0xFF8BAC0F, 0xFF306230, 0xFF0F380F };
+
+        // Uses the fastest path the host supports
+        ScanlineCompositor() : path(detect_path()) {}
+
+        // Fastest path the host CPU (and OS) supports
+        static Path detect_path();
+        static bool is_path_supported(Path path);
+        static const char* get_path_name(Path path);
+
+        Path get_path() const { return path; }
+
+        // Returns false (keeping the current path) if the host can't run it
+        bool set_path(Path path);
+
+        // Compose a line into out (WIDTH shades) - a sprite pixel shows where it is opaque and either in front of the
+        // background or over background color 0
+        void compose(const Layers& layers, uint8_t bgp, uint8_t obp0, uint8_t obp1, uint8_t* out) const;
+
+        // Map count shades to palette colors
+        void expand(const uint8_t* shades, int count, const uint32_t palette[4], uint32_t* out) const;
+    private:
+        Path path;
+};
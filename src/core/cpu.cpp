@@ -3,6 +3,38 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <cstdio>
+
+// Instruction sizes in bytes, taken from the opcode table
+static const uint8_t OPCODE_LENGTHS[256] = {
+#define CPU_OPCODE(op, name, fn, length, base_cycles) length,
+#include "cpu_opcodes.def"
+};
+
+// Opcodes that end a decoded block - anything that can change PC, IME or the halted state
+static bool ends_block(uint8_t opcode) {
+    switch (opcode) {
+        // Jumps and relative jumps
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9:
+        // Calls and returns
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9:
+        // Restarts
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+        // HALT, STOP, DI, EI
+        case 0x76: case 0x10: case 0xF3: case 0xFB:
+        // Illegal opcodes
+        case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Maximum cycles run in one block, so a block's total still fits in step()'s return value
+static const uint8_t BLOCK_CYCLE_LIMIT = 224;
 
 CPU::CPU() {
     init_instructions();
@@ -23,12 +55,13 @@ CPU::CPU() {
 }
 
 uint16_t CPU::get_af() const { 
-    return (static_cast<uint16_t>(a) << 8) | f;
+    return (static_cast<uint16_t>(a) << 8) | get_f();
 }
 
 void CPU::set_af(uint16_t value) {
     a = (value >> 8) & 0xFF; 
     f = value & 0xF0;
+    lazy_flags.op = FLAGS_NONE;
 }
 
 uint16_t CPU::get_bc() const { 
@@ -59,40 +92,107 @@ void CPU::set_hl(uint16_t value) {
 }
 
 bool CPU::get_flag_z() const { 
-    return (f & 0x80) != 0; 
+    return (get_f() & 0x80) != 0; 
 }
 
 void CPU::set_flag_z(bool value) { 
+    materialize_flags();
     f = (value)? (f | 0x80) : (f & ~0x80);
 }
 
 bool CPU::get_flag_n() const { 
-    return (f & 0x40) != 0; 
+    return (get_f() & 0x40) != 0; 
 }
 
 void CPU::set_flag_n(bool value) { 
+    materialize_flags();
     f = (value)? (f | 0x40) : (f & ~0x40);
 }
 
 bool CPU::get_flag_h() const { 
-    return (f & 0x20) != 0; 
+    return (get_f() & 0x20) != 0; 
 }
 
 void CPU::set_flag_h(bool value) { 
+    materialize_flags();
     f = (value)? (f | 0x20) : (f & ~0x20);
 }
 
 bool CPU::get_flag_c() const { 
-    return (f & 0x10) != 0; 
+    return get_carry() != 0; 
 }
 
 void CPU::set_flag_c(bool value) { 
+    materialize_flags();
     f = (value)? (f | 0x10) : (f & ~0x10);
 }
 
+uint8_t CPU::evaluate_flags(const LazyFlags& flags) {
+    uint8_t lhs = flags.lhs;
+    uint8_t rhs = flags.rhs;
+    uint8_t carry = flags.extra;
+
+    switch (flags.op) {
+        case FLAGS_ADD:
+            {
+                uint16_t sum = lhs + rhs + carry;
+                return ((sum & 0xFF) == 0 ? 0x80 : 0) |
+                       (((lhs & 0x0F) + (rhs & 0x0F) + carry) > 0x0F ? 0x20 : 0) |
+                       (sum > 0xFF ? 0x10 : 0);
+            }
+
+        case FLAGS_SUB:
+            {
+                int difference = lhs - rhs - carry;
+                return ((difference & 0xFF) == 0 ? 0x80 : 0) | 0x40 |
+                       (((lhs & 0x0F) - (rhs & 0x0F) - carry) < 0 ? 0x20 : 0) |
+                       (difference < 0 ? 0x10 : 0);
+            }
+
+        case FLAGS_INC:
+            return (lhs == 0xFF ? 0x80 : 0) | ((lhs & 0x0F) == 0x0F ? 0x20 : 0) | flags.extra;
+
+        case FLAGS_DEC:
+            return (lhs == 0x01 ? 0x80 : 0) | 0x40 | ((lhs & 0x0F) == 0 ? 0x20 : 0) | flags.extra;
+
+        case FLAGS_RESULT:
+            return (lhs == 0 ? 0x80 : 0) | flags.extra;
+
+        default:
+            return 0;
+    }
+}
+
+uint8_t CPU::evaluate_carry(const LazyFlags& flags) {
+    switch (flags.op) {
+        case FLAGS_ADD:
+            return (flags.lhs + flags.rhs + flags.extra) > 0xFF ? 0x10 : 0;
+
+        case FLAGS_SUB:
+            return (flags.lhs - flags.rhs - flags.extra) < 0 ? 0x10 : 0;
+
+        case FLAGS_INC:
+        case FLAGS_DEC:
+            return flags.extra;
+
+        case FLAGS_RESULT:
+            return flags.extra & 0x10;
+
+        default:
+            return 0;
+    }
+}
+
 void CPU::connect_mmu(MMU* m) {
     mmu = m;
 
+    // DIV and TIMA move on their own, so reads catch up first - TMA and TAC read back as written
+    mmu->register_io(0x04, 0x05, this,
+        [](void* cpu, uint8_t reg) { return static_cast<CPU*>(cpu)->read_timer_register(reg); },
+        [](void* cpu, uint8_t reg, uint8_t value) { static_cast<CPU*>(cpu)->write_timer_register(reg, value); });
+    mmu->register_io(0x06, 0x07, this, nullptr,
+        [](void* cpu, uint8_t reg, uint8_t value) { static_cast<CPU*>(cpu)->write_timer_register(reg, value); });
+
     // Initialize MMU state
     mmu->write_byte(0xFF40, 0x91); // LCDC: LCD On, BG On, Window Off, etc.
 
@@ -104,6 +204,47 @@ void CPU::connect_mmu(MMU* m) {
     mmu->write_byte(0xFFFF, 0x00); // IE
 }
 
+void CPU::connect_interrupts(InterruptController* i) {
+    interrupts = i;
+}
+
+void CPU::connect_scheduler(Scheduler* s) {
+    scheduler = s;
+    timers_cycle = scheduler->get_cycle();
+    schedule_timer_event();
+}
+
+void CPU::catch_up_timers() {
+    if (!scheduler) return;
+
+    // Move the timestamp first - the catch-up itself may touch the timer registers
+    uint64_t elapsed = scheduler->get_cycle() - timers_cycle;
+    timers_cycle = scheduler->get_cycle();
+
+    while (elapsed > 0) {
+        uint32_t run = static_cast<uint32_t>(std::min<uint64_t>(elapsed, UINT32_MAX));
+        tick_timers(run);
+        elapsed -= run;
+    }
+}
+
+void CPU::schedule_timer_event() {
+    if (!scheduler) return;
+
+    if (tima_reload_delay > 0) {
+        // TIMA only starts counting again (from TMA) once the reload is done
+        scheduler->schedule(Scheduler::EVENT_TIMER, timers_cycle + tima_reload_delay);
+        return;
+    }
+
+    uint32_t overflow = cycles_until_timer_overflow();
+    if (overflow == UINT32_MAX) {
+        scheduler->cancel(Scheduler::EVENT_TIMER);
+    } else {
+        scheduler->schedule(Scheduler::EVENT_TIMER, timers_cycle + overflow);
+    }
+}
+
 bool CPU::get_timer_enable_bit(uint16_t counter, uint8_t tac) {
     // Bit 2 of TAC is timer enable
     if (!(tac & 0x04)) return false;
@@ -124,55 +265,113 @@ bool CPU::get_timer_enable_bit(uint16_t counter, uint8_t tac) {
     return (counter & mask) != 0;
 }
 
-void CPU::tick_timers(uint8_t cycles) {
-    for (int i = 0; i < cycles; i++) {
-        // Handle pending reloads
-        bool in_reload = false;
+uint16_t CPU::get_timer_period(uint8_t tac) {
+    // TIMA increments when the selected counter bit falls, i.e. every 2^(bit + 1) cycles
+    static const uint16_t PERIODS[4] = { 1024, 16, 64, 256 };
+    return PERIODS[tac & 0x03];
+}
+
+uint32_t CPU::cycles_until_timer_overflow() const {
+    // The reload and its interrupt are still in flight
+    if (tima_reload_delay > 0) return 0;
+
+    uint8_t tac = mmu->get_io(0x07);
+    if (!(tac & 0x04)) return UINT32_MAX;
 
+    uint32_t period = get_timer_period(tac);
+    uint8_t tima = mmu->get_io(0x05);
+
+    // Next increment, then one full period for every increment left before TIMA wraps
+    return (period - (internal_counter & (period - 1))) + (0xFF - tima) * period;
+}
+
+void CPU::tick_timers(uint32_t cycles) {
+    // TIMA, TMA and TAC are accessed raw, since the timers are caught up from inside MMU reads and writes
+    uint8_t tac = mmu->get_io(0x07);
+    uint32_t period = get_timer_period(tac);
+
+    while (cycles > 0) {
+        // Pending reload - TIMA ignores falling edges until the cycle the reload lands on, which counts normally
         if (tima_reload_delay > 0) {
-            in_reload = true;
-            tima_reload_delay--;
-
-            // If delay hits 0, then reload TIMA from TMA
-            if (tima_reload_delay == 0) {
-                uint8_t tma = mmu->read_byte(0xFF06);
-                mmu->write_byte(0xFF05, tma);
-                
-                in_reload = false;
+            if (cycles < static_cast<uint32_t>(tima_reload_delay)) {
+                internal_counter += cycles;
+                tima_reload_delay -= cycles;
+                return;
             }
+
+            internal_counter += tima_reload_delay - 1;
+            cycles -= tima_reload_delay - 1;
+            tima_reload_delay = 0;
+            mmu->set_io(0x05, mmu->get_io(0x06));
         }
 
-        // Detect falling edge
-        uint8_t tac = mmu->read_byte(0xFF07);
-        bool old_signal = get_timer_enable_bit(internal_counter, tac);
-        
-        internal_counter++;
-        
-        bool new_signal = get_timer_enable_bit(internal_counter, tac);
-
-        // Increment TIMA on falling edge
-        if (old_signal && !new_signal && !in_reload) {
-            uint8_t tima = mmu->read_byte(0xFF05);
-            
-            // Increment TIMA
-            tima++;
-            
-            // If timer overflowed to 0, then reload after 4 cycle delay
-            if (tima == 0x00) {
-                mmu->write_byte(0xFF05, 0x00);
-                tima_reload_delay = 4; 
-
-                uint8_t if_reg = mmu->read_byte(0xFF0F);
-                mmu->write_byte(0xFF0F, if_reg | 0x04);
-            } else {
-                mmu->write_byte(0xFF05, tima);
-            }
+        // Falling edges of the selected counter bit in this span
+        uint32_t position = internal_counter & (period - 1);
+        uint32_t increments = (tac & 0x04) ? (position + cycles) / period : 0;
+        uint8_t tima = mmu->get_io(0x05);
+
+        if (increments <= static_cast<uint32_t>(0xFF - tima)) {
+            mmu->set_io(0x05, static_cast<uint8_t>(tima + increments));
+            internal_counter += cycles;
+            return;
         }
+
+        // TIMA overflows - it reads 0 and the reload from TMA (and the interrupt) follows 4 cycles later
+        uint32_t overflow = (period - position) + (0xFF - tima) * period;
+        internal_counter += overflow;
+        cycles -= overflow;
+
+        mmu->set_io(0x05, 0x00);
+        tima_reload_delay = 4;
+        interrupts->request(InterruptController::INT_TIMER);
+    }
+}
+
+uint8_t CPU::read_timer_register(uint8_t reg) {
+    catch_up_timers();
+
+    // DIV is the upper byte of the internal counter
+    if (reg == 0x04) {
+        return static_cast<uint8_t>(internal_counter >> 8);
     }
+
+    return mmu->get_io(reg);
+}
+
+void CPU::write_timer_register(uint8_t reg, uint8_t value) {
+    catch_up_timers();
+
+    switch (reg) {
+        // DIV register (0xFF04)
+        case 0x04:
+            // Writing to DIV register resets it
+            sync_timer_on_div_write();
+            break;
+
+        // TIMA (0xFF05)
+        case 0x05:
+            sync_timer_on_tima_write(value);
+            mmu->set_io(reg, value);
+            break;
+
+        // TMA (0xFF06)
+        case 0x06:
+            mmu->set_io(reg, value);
+            sync_timer_on_tma_write(value);
+            break;
+
+        // TAC (0xFF07)
+        case 0x07:
+            sync_timer_on_tac_write(value);
+            mmu->set_io(reg, value);
+            break;
+    }
+
+    schedule_timer_event();
 }
 
 void CPU::sync_timer_on_div_write() {
-    uint8_t tac = mmu->read_byte(0xFF07);
+    uint8_t tac = mmu->get_io(0x07);
     bool old_signal = get_timer_enable_bit(internal_counter, tac);
     
     internal_counter = 0;
@@ -181,34 +380,31 @@ void CPU::sync_timer_on_div_write() {
 
     // If signal fell, increment TIMA
     if (old_signal && !new_signal) {
-        uint8_t tima = mmu->read_byte(0xFF05);
-        tima++;
-        if (tima == 0x00) {
-            tima_reload_delay = 4;
-            uint8_t if_reg = mmu->read_byte(0xFF0F);
-            mmu->write_byte(0xFF0F, if_reg | 0x04);
-        } else {
-            mmu->write_byte(0xFF05, tima);
-        }
+        increment_tima();
     }
 }
 
 void CPU::sync_timer_on_tac_write(uint8_t new_tac) {
-    uint8_t old_tac = mmu->read_byte(0xFF07);
+    uint8_t old_tac = mmu->get_io(0x07);
     bool old_signal = get_timer_enable_bit(internal_counter, old_tac);
     bool new_signal = get_timer_enable_bit(internal_counter, new_tac);
 
     // If writing to TAC causes a falling edge (e.g. disabling timer), TIMA increments
     if (old_signal && !new_signal) {
-        uint8_t tima = mmu->read_byte(0xFF05);
-        tima++;
-        if (tima == 0x00) {
-            tima_reload_delay = 4;
-            uint8_t if_reg = mmu->read_byte(0xFF0F);
-            mmu->write_byte(0xFF0F, if_reg | 0x04);
-        } else {
-            mmu->write_byte(0xFF05, tima);
-        }
+        increment_tima();
+    }
+}
+
+void CPU::increment_tima() {
+    uint8_t tima = mmu->get_io(0x05);
+    tima++;
+    if (tima == 0x00) {
+        tima_reload_delay = 4;
+        interrupts->request(InterruptController::INT_TIMER);
+    } else {
+        // Stored the way a CPU write to TIMA is, which also cancels a reload that is more than a cycle away
+        sync_timer_on_tima_write(tima);
+        mmu->set_io(0x05, tima);
     }
 }
 
@@ -233,17 +429,14 @@ void CPU::reset_internal_counter() {
 }
 
 uint8_t CPU::handle_interrupts() {
-    uint8_t if_reg = mmu->read_byte(0xFF0F);
-    uint8_t ie_reg = mmu->read_byte(0xFFFF);
-    uint8_t pending = if_reg & ie_reg;
+    uint8_t pending = interrupts->get_pending();
+    if (pending == 0) return 0;
 
     // Any pending interrupt wakes the CPU
-    if (pending > 0) {
-        halted = false;
-        stopped = false;
-    }
+    halted = false;
+    stopped = false;
 
-    if (ime && pending > 0) {
+    if (ime) {
         // Services the highest priority interrupt first
 
         // Priority 1: V-Blank (0x0040)
@@ -285,13 +478,12 @@ uint8_t CPU::execute_interrupt(uint8_t bit, uint16_t vector) {
     mmu->write_byte(sp, (pc >> 8) & 0xFF);
 
     // Cancellation check - if the first push overwrote IE (0xFFFF) and disabled the intented interrupt, then abort
-    uint8_t ie_reg = mmu->read_byte(0xFFFF);
+    uint8_t ie_reg = interrupts->get_ie();
     
     // Check if current interrupt bit is still enabled
     if (!(ie_reg & (1 << bit))) {
         // The original interrupt was disabled by the push; re-evaluate if any interrupt is now valid
-        uint8_t if_reg = mmu->read_byte(0xFF0F);
-        uint8_t pending = if_reg & ie_reg & 0x1F;
+        uint8_t pending = interrupts->get_pending() & 0x1F;
 
         if (pending == 0) {
             // No interrupts are enabled, cancel dispatch
@@ -316,8 +508,7 @@ uint8_t CPU::execute_interrupt(uint8_t bit, uint16_t vector) {
     mmu->write_byte(sp, pc & 0xFF);
     
     // Clear the specific interrupt bit in IF register
-    uint8_t if_reg = mmu->read_byte(0xFF0F);
-    mmu->write_byte(0xFF0F, if_reg & ~(1 << bit));
+    interrupts->acknowledge(static_cast<InterruptController::Interrupt>(bit));
     
     // Jump to vector
     pc = vector;
@@ -326,28 +517,36 @@ uint8_t CPU::execute_interrupt(uint8_t bit, uint16_t vector) {
 }
 
 uint8_t CPU::step() {
-    if (!mmu) {
-        throw std::runtime_error("[CPU] MMU was not connected to CPU before execution");
+    if (!mmu || !interrupts) {
+        throw std::runtime_error("[CPU] MMU and interrupt controller must be connected to CPU before execution");
     }
 
+    if (fault_halted) return 0;
+
     // Interupt handling
     uint8_t int_cycles = handle_interrupts();
     if (int_cycles > 0) {
-        total_cycles += int_cycles;
+        spend_cycles(int_cycles);
         return int_cycles; 
     }
 
     // If halted or stopped, skip instruction execution
     if (halted || stopped) {
-        total_cycles += 4;
+        spend_cycles(4);
         return 4;
     }
 
-    uint8_t opcode = mmu->read_byte(pc);
+    if (block_cache_enabled && !mmu->requires_interpreter()) {
+        return execute_block();
+    }
+
+    uint8_t opcode = fetch_instruction();
     log_instruction(opcode);
-    pc++;
+    instruction_pc = pc++;
 
-    uint8_t cycles = (this->*instructions[opcode].operate)();
+    total_instructions++;
+
+    uint8_t cycles = execute(opcode);
 
     // Handle IME delay
     if (ime_delay > 0) {
@@ -357,14 +556,282 @@ uint8_t CPU::step() {
         }
     }
 
-    total_cycles += cycles;
+    spend_cycles(cycles);
+    return cycles;
+}
+
+uint8_t CPU::fetch_instruction() {
+    uint8_t opcode = mmu->fetch_byte(pc);
+
+    // Operand bytes come straight after the opcode
+    switch (OPCODE_LENGTHS[opcode]) {
+        case 3: operands[1] = mmu->fetch_byte(pc + 2); // fallthrough
+        case 2: operands[0] = mmu->fetch_byte(pc + 1); break;
+    }
+
+    return opcode;
+}
+
+void CPU::set_block_cache_enabled(bool enabled) {
+    block_cache_enabled = enabled;
+    block_cache.clear();
+
+#ifdef GAMEBYTE_JIT
+    // Compiled code hangs off cached blocks
+    if (!enabled) {
+        jit.reset();
+    }
+#endif
+}
+
+void CPU::set_jit_enabled(bool enabled) {
+#ifdef GAMEBYTE_JIT
+    if (enabled) {
+        if (!jit) {
+            jit.reset(new JIT(this));
+        }
+        set_block_cache_enabled(true);
+    } else {
+        jit.reset();
+        block_cache.clear();
+    }
+#else
+    if (enabled) {
+        throw std::runtime_error("[CPU] This build has no JIT (it needs an x86-64 host and GAMEBYTE_JIT=ON)");
+    }
+#endif
+}
+
+bool CPU::is_jit_enabled() const {
+#ifdef GAMEBYTE_JIT
+    return jit != nullptr;
+#else
+    return false;
+#endif
+}
+
+void CPU::notify_code_write(uint16_t address) {
+    block_cache.invalidate(address);
+    block_aborted = true;
+}
+
+void CPU::notify_rom_bank_change() {
+    // Blocks are keyed by bank so they stay valid, but the block being run may have just been switched out
+    block_aborted = true;
+}
+
+void CPU::notify_dma_start() {
+    block_aborted = true;
+}
+
+uint8_t CPU::execute_block() {
+    uint16_t bank = mmu->get_code_bank(pc);
+    BlockCache::Block* block = block_cache.lookup(pc, bank);
+
+    if (!block) {
+        block = decode_block(bank);
+    }
+
+#ifdef GAMEBYTE_JIT
+    // Hot blocks run as compiled code - except while an EI delay is pending, which needs the per-instruction loop
+    if (jit && ime_delay == 0) {
+        if (!block->native && ++block->run_count == JIT::HOT_THRESHOLD) {
+            block->native = jit->compile(*block);
+        }
+
+        if (block->native) {
+            // Compiled code moves the clock after every instruction but the last, which may take a variable number
+            // of cycles - the rest is made up here
+            uint64_t start_cycle = scheduler ? scheduler->get_cycle() : 0;
+            materialize_flags();
+            uint32_t native_cycles = jit->run(block->native);
+            total_cycles += native_cycles;
+            if (scheduler) {
+                scheduler->advance(static_cast<uint32_t>(start_cycle + native_cycles - scheduler->get_cycle()));
+            }
+            return static_cast<uint8_t>(native_cycles);
+        }
+    }
+#endif
+
+    uint8_t cycles = 0;
+    block_aborted = false;
+
+    for (int i = 0; i < block->count; i++) {
+        const BlockCache::DecodedInstruction& instruction = block->instructions[i];
+        operands[0] = instruction.operands[0];
+        operands[1] = instruction.operands[1];
+
+        log_instruction(instruction.opcode);
+        instruction_pc = pc++;
+
+        total_instructions++;
+
+        uint8_t instruction_cycles = execute(instruction.opcode);
+        cycles += instruction_cycles;
+
+        // The clock moves with every instruction, so the next one sees I/O registers at their exact cycle - and the
+        // block ends where an event comes due, to be handled before anything else runs
+        bool event_due = spend_cycles(instruction_cycles);
+
+        // Handle IME delay - interrupts have to be checked as soon as IME turns on, so end the block there
+        if (ime_delay > 0) {
+            ime_delay--;
+            if (ime_delay == 0) {
+                ime = true;
+                break;
+            }
+        }
+
+        // Stop early if an event is due, the block's code changed under it, or before the cycle count can overflow
+        if (event_due || block_aborted || cycles >= BLOCK_CYCLE_LIMIT) {
+            break;
+        }
+    }
+
     return cycles;
 }
 
+BlockCache::Block* CPU::decode_block(uint16_t bank) {
+    // Code outside ROM/WRAM/HRAM is decoded as a single-instruction block that is never stored
+    bool cacheable = BlockCache::is_cacheable(pc);
+    BlockCache::Block& block = cacheable ? block_cache.allocate(pc, bank) : uncached_block;
+    block.count = 0;
+    block.run_count = 0;
+    block.native = nullptr;
+
+    uint16_t address = pc;
+    while (block.count < BlockCache::MAX_BLOCK_INSTRUCTIONS) {
+        uint8_t opcode = mmu->read_byte(address);
+
+        // HALT, STOP, DI and EI behave differently depending on whether an interrupt was serviced just before them,
+        // and interrupts are only checked between blocks - so they always start a block of their own
+        if (block.count > 0 && (opcode == 0x76 || opcode == 0x10 || opcode == 0xF3 || opcode == 0xFB)) break;
+
+        BlockCache::DecodedInstruction& instruction = block.instructions[block.count++];
+        instruction.opcode = opcode;
+        instruction.length = OPCODE_LENGTHS[instruction.opcode];
+        instruction.operands[0] = (instruction.length > 1) ? mmu->read_byte(address + 1) : 0;
+        instruction.operands[1] = (instruction.length > 2) ? mmu->read_byte(address + 2) : 0;
+        address += instruction.length;
+
+        if (!cacheable || ends_block(instruction.opcode)) break;
+
+        // Don't run off the end of the memory region (or ROM bank window) the block started in
+        uint16_t region_end = (pc <= 0x3FFF) ? 0x4000 : (pc <= 0x7FFF) ? 0x8000 : (pc <= 0xDFFF) ? 0xE000 : 0xFFFF;
+        if (address + 2 >= region_end) break;
+    }
+
+    block.end = address;
+    if (cacheable) {
+        block_cache.mark_code(block);
+    }
+
+    return &block;
+}
+
+uint8_t CPU::execute(uint8_t opcode) {
+#ifdef GAMEBYTE_LEGACY_DISPATCH
+    return (this->*instructions[opcode].operate)();
+#else
+    // Dense switch over every opcode - each case is a direct call, so handlers can be inlined
+    switch (opcode) {
+#define CPU_OPCODE(op, name, fn, length, base_cycles) case op: return fn();
+#include "cpu_opcodes.def"
+    }
+
+    // Unreachable, every opcode has a handler
+    return 0;
+#endif
+}
+
+uint32_t CPU::run(uint32_t cycle_budget) {
+    if (!mmu || !interrupts) {
+        throw std::runtime_error("[CPU] MMU and interrupt controller must be connected to CPU before execution");
+    }
+
+    uint32_t cycles_run = 0;
+    uint8_t cycles = 0;
+    uint8_t opcode = 0;
+
+#if defined(GAMEBYTE_COMPUTED_GOTO)
+    // Threaded interpreter - every handler ends with its own copy of the fetch and indirect jump,
+    // so the host branch predictor sees a separate dispatch point per opcode
+    static const void* const dispatch_table[256] = {
+#define CPU_OPCODE(op, name, fn, length, base_cycles) &&handler_##op,
+#include "cpu_opcodes.def"
+    };
+
+    // A halt and a read of LY or STAT (the start of every busy-wait loop GameBoy::skip_idle() knows) end the
+    // batch, so the caller gets a chance to skip ahead
+#define CPU_FETCH_AND_DISPATCH()                        \
+    do {                                                \
+        if (cycles_run >= cycle_budget || fault_halted) return cycles_run; \
+        cycles = handle_interrupts();                   \
+        if (cycles > 0) goto cycles_spent;              \
+        if (halted || stopped) {                        \
+            if (cycles_run > 0) return cycles_run;      \
+            cycles = 4;                                 \
+            goto cycles_spent;                          \
+        }                                               \
+        opcode = fetch_instruction();                   \
+        if (opcode == 0xF0 && is_idle_poll() && cycles_run > 0) return cycles_run; \
+        log_instruction(opcode);                        \
+        instruction_pc = pc++;                          \
+        total_instructions++;                           \
+        goto *dispatch_table[opcode];                   \
+    } while (0)
+
+    CPU_FETCH_AND_DISPATCH();
+
+cycles_spent:
+    cycles_run += cycles;
+    if (spend_cycles(cycles)) return cycles_run;
+    CPU_FETCH_AND_DISPATCH();
+
+#define CPU_OPCODE(op, name, fn, length, base_cycles)                \
+handler_##op:                                           \
+    cycles = fn();                                      \
+    if (ime_delay > 0 && --ime_delay == 0) ime = true;  \
+    cycles_run += cycles;                               \
+    if (spend_cycles(cycles)) return cycles_run;        \
+    CPU_FETCH_AND_DISPATCH();
+#include "cpu_opcodes.def"
+
+#undef CPU_FETCH_AND_DISPATCH
+#else
+    // Portable fallback - same loop as step(), but kept inside one function around the opcode switch
+    while (cycles_run < cycle_budget && !fault_halted) {
+        cycles = handle_interrupts();
+        if (cycles == 0) {
+            if (halted || stopped) {
+                if (cycles_run > 0) break;
+                cycles = 4;
+            } else {
+                opcode = fetch_instruction();
+                if (opcode == 0xF0 && is_idle_poll() && cycles_run > 0) break;
+                log_instruction(opcode);
+                instruction_pc = pc++;
+                total_instructions++;
+
+                cycles = execute(opcode);
+                if (ime_delay > 0 && --ime_delay == 0) ime = true;
+            }
+        }
+
+        cycles_run += cycles;
+        if (spend_cycles(cycles)) break;
+    }
+
+    return cycles_run;
+#endif
+}
+
 void CPU::log_instruction(uint8_t opcode) {
     InstructionLog& log = history[history_pos];
     log.pc = pc;
     log.opcode = opcode;
+    log.operand = operands[0];
     log.a = a;
     log.b = b;
     log.c = c;
@@ -374,6 +841,7 @@ void CPU::log_instruction(uint8_t opcode) {
     log.l = l;
     log.f = f;
     log.sp = sp;
+    log.flags = lazy_flags;
 
     history_pos++;
     if (history_pos >= HISTORY_SIZE) {
@@ -393,6 +861,7 @@ void CPU::dump_history() {
     for (size_t i = 0; i < count; i++) {
         size_t idx = (start_pos + i) % HISTORY_SIZE;
         const InstructionLog& log = history[idx];
+        uint8_t flags = log.flags.op == FLAGS_NONE ? log.f : evaluate_flags(log.flags);
         
         // Format output
         std::cout << "0x" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << log.pc << " | ";
@@ -402,6 +871,9 @@ void CPU::dump_history() {
         if (log.opcode < instructions.size()) {
             mnemonic = instructions[log.opcode].name ? instructions[log.opcode].name : "UNIMPLEMENTED";
         }
+        if (log.opcode == 0xCB) {
+            mnemonic = cb_instructions[log.operand];
+        }
         std::cout << std::left << std::setw(16) << std::setfill(' ') << mnemonic << " | ";
         
         std::cout << std::right << std::setfill('0');
@@ -412,15 +884,77 @@ void CPU::dump_history() {
         std::cout << "E:" << std::setw(2) << static_cast<int>(log.e) << " ";
         std::cout << "H:" << std::setw(2) << static_cast<int>(log.h) << " ";
         std::cout << "L:" << std::setw(2) << static_cast<int>(log.l) << " ";
-        std::cout << "F:" << std::setw(2) << static_cast<int>(log.f) << " ";
+        std::cout << "F:" << std::setw(2) << static_cast<int>(flags) << " ";
         std::cout << "SP:" << std::setw(4) << log.sp << std::endl;
     }
-    std::cout << "======================================================================\n" << std::dec;
+    std::cout << "======================================================================\n" << std::dec << std::nouppercase;
+}
+
+void CPU::record_watch_hit(uint8_t kind, uint16_t address, uint8_t value) {
+    WatchHit& hit = watch_hits[watch_hits_pos];
+
+    // Fetches happen before the instruction starts, data accesses while it runs
+    hit.pc = (kind == MMU::WATCH_EXECUTE) ? pc : instruction_pc;
+    hit.address = address;
+    hit.value = value;
+    hit.kind = kind;
+    hit.cycle = scheduler ? scheduler->get_cycle() : total_cycles;
+
+    watch_hits_pos++;
+    if (watch_hits_pos >= WATCH_HISTORY_SIZE) {
+        watch_hits_pos = 0;
+        watch_hits_wrapped = true;
+    }
+}
+
+void CPU::raise_fault(Fault::Type type, uint16_t address) {
+    if (fault_policy == FAULT_POLICY_IGNORE) return;
+
+    fault.type = type;
+    fault.pc = instruction_pc;
+    fault.address = address;
+    fault.cycle = scheduler ? scheduler->get_cycle() : total_cycles;
+
+    if (fault_policy == FAULT_POLICY_LOG) {
+        printf("[CPU] %s at 0x%04X (PC 0x%04X, cycle %llu)\n", Fault::describe(type), address, fault.pc,
+               static_cast<unsigned long long>(fault.cycle));
+        return;
+    }
+
+    // Finish the current instruction, but not the rest of its block
+    fault_halted = true;
+    block_aborted = true;
+}
+
+void CPU::clear_fault() {
+    fault = Fault();
+    fault_halted = false;
+}
+
+void CPU::dump_watch_hits() {
+    std::cout << "\n=== WATCHPOINT HITS (Last " << WATCH_HISTORY_SIZE << ") ===\n";
+    std::cout << "PC     | Access | Address | Value | Cycle\n";
+    std::cout << "-------|--------|---------|-------|----------------\n";
+
+    size_t start_pos = watch_hits_wrapped ? watch_hits_pos : 0;
+    size_t count = watch_hits_wrapped ? WATCH_HISTORY_SIZE : watch_hits_pos;
+
+    for (size_t i = 0; i < count; i++) {
+        const WatchHit& hit = watch_hits[(start_pos + i) % WATCH_HISTORY_SIZE];
+        const char* access = (hit.kind == MMU::WATCH_READ) ? "read  " : (hit.kind == MMU::WATCH_WRITE) ? "write " : "exec  ";
+
+        std::cout << "0x" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << hit.pc << " | ";
+        std::cout << access << " | ";
+        std::cout << "0x" << std::setw(4) << hit.address << "  | ";
+        std::cout << "0x" << std::setw(2) << static_cast<int>(hit.value) << "  | ";
+        std::cout << std::dec << hit.cycle << std::endl;
+    }
+    std::cout << "======================================================================\n" << std::dec << std::nouppercase;
 }
 
 void CPU::debug_interrupt_status() {
-    uint8_t if_reg = mmu->read_byte(0xFF0F); // Interrupt flag (requests)
-    uint8_t ie_reg = mmu->read_byte(0xFFFF); // Interrupt enable
+    uint8_t if_reg = interrupts->get_if(); // Interrupt flag (requests)
+    uint8_t ie_reg = interrupts->get_ie(); // Interrupt enable
     uint8_t ly_reg = mmu->read_byte(0xFF44); // Current scanline
     uint8_t lcdc   = mmu->read_byte(0xFF40); // LCD control
 
@@ -437,446 +971,165 @@ void CPU::debug_interrupt_status() {
 }
 
 // Extended opcode implementation 
-uint8_t CPU::execute_cb_instruction(uint8_t opcode) {
-    // Determine register target based on bottom 3 bits
-    uint8_t* registers[] = { &b, &c, &d, &e, &h, &l, nullptr, &a };
-    uint8_t target_idx = opcode & 0x07;
-    
+namespace {
+    // Registers selected by the low 3 bits of an extended opcode - 6 is [HL]
+    constexpr uint8_t CPU::* CB_REGISTERS[8] = { &CPU::b, &CPU::c, &CPU::d, &CPU::e, &CPU::h, &CPU::l, nullptr, &CPU::a };
+
+    // Mnemonics of the extended opcodes ("RLC B", "BIT 7, [HL]", ...), built at compile time
+    struct CBNames {
+        char text[256][12];
+    };
+
+    constexpr CBNames make_cb_names() {
+        const char* shifts[8] = { "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL" };
+        const char* groups[4] = { nullptr, "BIT", "RES", "SET" };
+        const char* targets[8] = { "B", "C", "D", "E", "H", "L", "[HL]", "A" };
+
+        CBNames names{};
+        for (int opcode = 0; opcode < 256; opcode++) {
+            char* out = names.text[opcode];
+            int bit = (opcode >> 3) & 0x07;
+
+            for (const char* s = (opcode < 0x40) ? shifts[bit] : groups[opcode >> 6]; *s; s++) *out++ = *s;
+            *out++ = ' ';
+            if (opcode >= 0x40) {
+                *out++ = static_cast<char>('0' + bit);
+                *out++ = ',';
+                *out++ = ' ';
+            }
+            for (const char* s = targets[opcode & 0x07]; *s; s++) *out++ = *s;
+        }
+        return names;
+    }
+
+    constexpr CBNames CB_NAMES = make_cb_names();
+}
+
+template <uint8_t opcode>
+uint8_t CPU::CB_OP() {
+    constexpr uint8_t target = opcode & 0x07;
+    constexpr uint8_t bit = (opcode >> 3) & 0x07;
+    constexpr uint8_t mask = 1 << bit;
+
     // Most CB instructions take 8 cycles, but [HL] operations take 16
-    uint8_t cycles = (target_idx == 6) ? 16 : 8;
+    constexpr uint8_t cycles = (target == 6) ? 16 : 8;
 
     uint8_t value;
-    // Check if target is memory ([HL]) or register
-    if (target_idx == 6) {
+    if constexpr (target == 6) {
         value = mmu->read_byte(get_hl());
     } else {
-        value = *registers[target_idx];
+        value = this->*CB_REGISTERS[target];
     }
 
-    // Decode the top two bits for the category
-    switch (opcode >> 6) {
-        // Shifts and Rotates (0x00 - 0x3F)
-        case 0x00:
-            value = handle_cb_shift_rotate(opcode, value);
-            set_flag_z(value == 0);
-            set_flag_n(false);
-            set_flag_h(false);
-            break;
-
-        // BIT (0x40 - 0x7F)
-        case 0x01:
-            {
-                uint8_t bit = (opcode >> 3) & 0x07;
-                set_flag_z(!(value & (1 << bit)));
-                set_flag_n(false);
-                set_flag_h(true);
-
-                // BIT doesn't write back
-                return cycles;
-            }
+    // Shifts and Rotates (0x00 - 0x3F)
+    if constexpr (opcode < 0x40) {
+        bool carry;
 
-        // RES (0x80 - 0xBF)
-        case 0x02:
-            {
-                uint8_t bit = (opcode >> 3) & 0x07;
-                value &= ~(1 << bit);
-            }
-            break;
+        if constexpr (bit == 0) {
+            // RLC (Rotate Left)
+            carry = value & 0x80;
+            value = (value << 1) | (value >> 7);
+        } else if constexpr (bit == 1) {
+            // RRC (Rotate Right)
+            carry = value & 0x01;
+            value = (value >> 1) | (value << 7);
+        } else if constexpr (bit == 2) {
+            // RL (Rotate Left through Carry)
+            carry = value & 0x80;
+            value = (value << 1) | (get_carry() >> 4);
+        } else if constexpr (bit == 3) {
+            // RR (Rotate Right through Carry)
+            carry = value & 0x01;
+            value = (value >> 1) | (get_carry() << 3);
+        } else if constexpr (bit == 4) {
+            // SLA (Shift Left Arithmetic)
+            carry = value & 0x80;
+            value <<= 1;
+        } else if constexpr (bit == 5) {
+            // SRA (Shift Right Arithmetic - preserve bit 7)
+            carry = value & 0x01;
+            value = (static_cast<int8_t>(value)) >> 1;
+        } else if constexpr (bit == 6) {
+            // SWAP (Swap nibbles)
+            carry = false;
+            value = ((value & 0x0F) << 4) | ((value & 0xF0) >> 4);
+        } else {
+            // SRL (Shift Right Logical)
+            carry = value & 0x01;
+            value >>= 1;
+        }
 
-        // SET (0xC0 - 0xFF)
-        case 0x03:
-            {
-                uint8_t bit = (opcode >> 3) & 0x07;
-                value |= (1 << bit);
-            }
-            break;
+        set_flags_result(value, carry ? 0x10 : 0);
+    }
+    // BIT (0x40 - 0x7F)
+    else if constexpr (opcode < 0x80) {
+        set_flags_result(value & mask, 0x20 | get_carry());
 
-        // BIT 7, H
-        case 0x7C:
-            set_flag_z(!(h & 0x80));
-            set_flag_n(false);
-            set_flag_h(true);
-            break;
+        // BIT doesn't write back
+        return cycles;
+    }
+    // RES (0x80 - 0xBF)
+    else if constexpr (opcode < 0xC0) {
+        value &= ~mask;
+    }
+    // SET (0xC0 - 0xFF)
+    else {
+        value |= mask;
     }
 
     // Write the result back
-    if (target_idx == 6) {
+    if constexpr (target == 6) {
         mmu->write_byte(get_hl(), value);
     } else {
-        *registers[target_idx] = value;
+        this->*CB_REGISTERS[target] = value;
     }
 
     return cycles;
 }
 
-uint8_t CPU::handle_cb_shift_rotate(uint8_t opcode, uint8_t value) {
-    uint8_t sub_op = (opcode >> 3) & 0x07;
-    bool old_carry = get_flag_c();
-
-    switch (sub_op) {
-        // RLC (Rotate Left)
-        case 0:
-            set_flag_c(value & 0x80);
-            value = (value << 1) | (value >> 7);
-            break;
-
-        // RRC (Rotate Right)
-        case 1:
-            set_flag_c(value & 0x01);
-            value = (value >> 1) | (value << 7);
-            break;
-        
-        // RL (Rotate Left through Carry)
-        case 2:
-            set_flag_c(value & 0x80);
-            value = (value << 1) | (old_carry ? 1 : 0);
-            break;
-
-        // RR (Rotate Right through Carry)
-        case 3:
-            set_flag_c(value & 0x01);
-            value = (value >> 1) | (old_carry ? 0x80 : 0);
-            break;
+template <size_t... opcodes>
+constexpr std::array<const char*, 256> CPU::make_cb_instructions(std::index_sequence<opcodes...>) {
+    return {{ CB_NAMES.text[opcodes]... }};
+}
 
-        // SLA (Shift Left Arithmetic)
-        case 4:
-            set_flag_c(value & 0x80);
-            value <<= 1;
-            break;
+const std::array<const char*, 256> CPU::cb_instructions = CPU::make_cb_instructions(std::make_index_sequence<256>());
 
-        // SRA (Shift Right Arithmetic - preserve bit 7)
-        case 5:
-            set_flag_c(value & 0x01);
-            value = (static_cast<int8_t>(value)) >> 1;
-            break;
-        
-        // SWAP (Swap nibbles)
-        case 6:
-            set_flag_c(false);
-            value = ((value & 0x0F) << 4) | ((value & 0xF0) >> 4);
-            break;
-
-        // SRL (Shift Right Logical)
-        case 7:
-            set_flag_c(value & 0x01);
-            value >>= 1;
-            break;
+uint8_t CPU::execute_cb_instruction(uint8_t opcode) {
+    // Dense switch over every extended opcode - each case is a direct call, so CB_OP can be inlined
+    switch (opcode) {
+#define CB_CASE(op) case (op): return CB_OP<(op)>();
+#define CB_CASE_4(op) CB_CASE(op) CB_CASE((op) + 1) CB_CASE((op) + 2) CB_CASE((op) + 3)
+#define CB_CASE_16(op) CB_CASE_4(op) CB_CASE_4((op) + 4) CB_CASE_4((op) + 8) CB_CASE_4((op) + 12)
+#define CB_CASE_64(op) CB_CASE_16(op) CB_CASE_16((op) + 16) CB_CASE_16((op) + 32) CB_CASE_16((op) + 48)
+        CB_CASE_64(0x00)
+        CB_CASE_64(0x40)
+        CB_CASE_64(0x80)
+        CB_CASE_64(0xC0)
+#undef CB_CASE_64
+#undef CB_CASE_16
+#undef CB_CASE_4
+#undef CB_CASE
     }
 
-    set_flag_z(value == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    return value;
+    // Unreachable, every extended opcode has a handler
+    return 0;
 }
 
 void CPU::init_instructions() {
     instructions.assign(256, { "XXX", &CPU::XXX });
 
-    // 0x00 - 0x0F
-    instructions[0x00] = { "NOP", &CPU::NOP };
-    instructions[0x01] = { "LD BC, n16", &CPU::LD_BC_n16 };
-    instructions[0x02] = { "LD (BC), A", &CPU::LD_BC_ptr_A };
-    instructions[0x03] = { "INC BC", &CPU::INC_BC };
-    instructions[0x04] = { "INC B", &CPU::INC_B };
-    instructions[0x05] = { "DEC B", &CPU::DEC_B };
-    instructions[0x06] = { "LD B, n8", &CPU::LD_B_n8 };
-    instructions[0x07] = { "RLCA", &CPU::RLCA };
-    instructions[0x08] = { "LD [a16], SP", &CPU::LD_a16_SP };
-    instructions[0x09] = { "ADD HL, BC", &CPU::ADD_HL_BC };
-    instructions[0x0A] = { "LD A, (BC)", &CPU::LD_A_BC_ptr };
-    instructions[0x0B] = { "DEC BC", &CPU::DEC_BC };
-    instructions[0x0C] = { "INC C", &CPU::INC_C };
-    instructions[0x0D] = { "DEC C", &CPU::DEC_C };
-    instructions[0x0E] = { "LD C, n8", &CPU::LD_C_n8 };
-    instructions[0x0F] = { "RRCA", &CPU::RRCA };
-
-    // 0x10 - 0x1F
-    instructions[0x10] = { "STOP", &CPU::STOP };
-    instructions[0x11] = { "LD DE, n16", &CPU::LD_DE_n16 };
-    instructions[0x12] = { "LD (DE), A", &CPU::LD_DE_ptr_A };
-    instructions[0x13] = { "INC DE", &CPU::INC_DE };
-    instructions[0x14] = { "INC D", &CPU::INC_D };
-    instructions[0x15] = { "DEC D", &CPU::DEC_D };
-    instructions[0x16] = { "LD D, n8", &CPU::LD_D_n8 };
-    instructions[0x17] = { "RLA", &CPU::RLA };
-    instructions[0x18] = { "JR e8", &CPU::JR_e8 };
-    instructions[0x19] = { "ADD HL, DE", &CPU::ADD_HL_DE };
-    instructions[0x1A] = { "LD A, (DE)", &CPU::LD_A_DE_ptr };
-    instructions[0x1B] = { "DEC DE", &CPU::DEC_DE };
-    instructions[0x1C] = { "INC E", &CPU::INC_E };
-    instructions[0x1D] = { "DEC E", &CPU::DEC_E };
-    instructions[0x1E] = { "LD E, n8", &CPU::LD_E_n8 };
-    instructions[0x1F] = { "RRA", &CPU::RRA };
-
-    // 0x20 - 0x2F
-    instructions[0x20] = { "JR NZ, e8", &CPU::JR_NZ_e8 };
-    instructions[0x21] = { "LD HL, n16", &CPU::LD_HL_n16 };
-    instructions[0x22] = { "LD (HL+), A", &CPU::LD_HL_ptr_inc_A };
-    instructions[0x23] = { "INC HL", &CPU::INC_HL };
-    instructions[0x24] = { "INC H", &CPU::INC_H };
-    instructions[0x25] = { "DEC H", &CPU::DEC_H };
-    instructions[0x26] = { "LD H, n8", &CPU::LD_H_n8 };
-    instructions[0x27] = { "DAA", &CPU::DAA };
-    instructions[0x28] = { "JR Z, e8", &CPU::JR_Z_e8 };
-    instructions[0x29] = { "ADD HL, HL", &CPU::ADD_HL_HL };
-    instructions[0x2A] = { "LD A, (HL+)", &CPU::LD_A_HL_ptr_inc };
-    instructions[0x2B] = { "DEC HL", &CPU::DEC_HL };
-    instructions[0x2C] = { "INC L", &CPU::INC_L };
-    instructions[0x2D] = { "DEC L", &CPU::DEC_L };
-    instructions[0x2E] = { "LD L, n8", &CPU::LD_L_n8 };
-    instructions[0x2F] = { "CPL", &CPU::CPL };
-
-    // 0x30 - 0x3F
-    instructions[0x30] = { "JR NC, e8", &CPU::JR_NC_e8 };
-    instructions[0x31] = { "LD SP, n16", &CPU::LD_SP_n16 };
-    instructions[0x32] = { "LD (HL-), A", &CPU::LD_HL_ptr_dec_A };
-    instructions[0x33] = { "INC SP", &CPU::INC_SP };
-    instructions[0x34] = { "INC [HL]", &CPU::INC_at_HL };
-    instructions[0x35] = { "DEC [HL]", &CPU::DEC_at_HL };
-    instructions[0x36] = { "LD [HL], n8", &CPU::LD_HL_n8 };
-    instructions[0x37] = { "SCF", &CPU::SCF };
-    instructions[0x38] = { "JR C, e8", &CPU::JR_C_e8 };
-    instructions[0x39] = { "ADD HL, SP", &CPU::ADD_HL_SP };
-    instructions[0x3A] = { "LD A, (HL-)", &CPU::LD_A_HL_ptr_dec };
-    instructions[0x3B] = { "DEC SP", &CPU::DEC_SP };
-    instructions[0x3C] = { "INC A", &CPU::INC_A };
-    instructions[0x3D] = { "DEC A", &CPU::DEC_A };
-    instructions[0x3E] = { "LD A, n8", &CPU::LD_A_n8 };
-    instructions[0x3F] = { "CCF", &CPU::CCF };
-
-    // 0x40 - 0x4F
-    instructions[0x40] = { "LD B, B", &CPU::LD_B_B };
-    instructions[0x41] = { "LD B, C", &CPU::LD_B_C };
-    instructions[0x42] = { "LD B, D", &CPU::LD_B_D };
-    instructions[0x43] = { "LD B, E", &CPU::LD_B_E };
-    instructions[0x44] = { "LD B, H", &CPU::LD_B_H };
-    instructions[0x45] = { "LD B, L", &CPU::LD_B_L };
-    instructions[0x46] = { "LD B, [HL]", &CPU::LD_B_HL };
-    instructions[0x47] = { "LD B, A", &CPU::LD_B_A };
-    instructions[0x48] = { "LD C, B", &CPU::LD_C_B };
-    instructions[0x49] = { "LD C, C", &CPU::LD_C_C };
-    instructions[0x4A] = { "LD C, D", &CPU::LD_C_D };
-    instructions[0x4B] = { "LD C, E", &CPU::LD_C_E };
-    instructions[0x4C] = { "LD C, H", &CPU::LD_C_H };
-    instructions[0x4D] = { "LD C, L", &CPU::LD_C_L };
-    instructions[0x4E] = { "LD C, [HL]", &CPU::LD_C_HL };
-    instructions[0x4F] = { "LD C, A", &CPU::LD_C_A };
-
-    // 0x50 - 0x5F
-    instructions[0x50] = { "LD D, B", &CPU::LD_D_B };
-    instructions[0x51] = { "LD D, C", &CPU::LD_D_C };
-    instructions[0x52] = { "LD D, D", &CPU::LD_D_D };
-    instructions[0x53] = { "LD D, E", &CPU::LD_D_E };
-    instructions[0x54] = { "LD D, H", &CPU::LD_D_H };
-    instructions[0x55] = { "LD D, L", &CPU::LD_D_L };
-    instructions[0x56] = { "LD D, [HL]", &CPU::LD_D_HL };
-    instructions[0x57] = { "LD D, A", &CPU::LD_D_A };
-    instructions[0x58] = { "LD E, B", &CPU::LD_E_B };
-    instructions[0x59] = { "LD E, C", &CPU::LD_E_C };
-    instructions[0x5A] = { "LD E, D", &CPU::LD_E_D };
-    instructions[0x5B] = { "LD E, E", &CPU::LD_E_E };
-    instructions[0x5C] = { "LD E, H", &CPU::LD_E_H };
-    instructions[0x5D] = { "LD E, L", &CPU::LD_E_L };
-    instructions[0x5E] = { "LD E, [HL]", &CPU::LD_E_HL };
-    instructions[0x5F] = { "LD E, A", &CPU::LD_E_A };
-
-    // 0x60 - 0x6F
-    instructions[0x60] = { "LD H, B", &CPU::LD_H_B };
-    instructions[0x61] = { "LD H, C", &CPU::LD_H_C };
-    instructions[0x62] = { "LD H, D", &CPU::LD_H_D };
-    instructions[0x63] = { "LD H, E", &CPU::LD_H_E };
-    instructions[0x64] = { "LD H, H", &CPU::LD_H_H };
-    instructions[0x65] = { "LD H, L", &CPU::LD_H_L };
-    instructions[0x66] = { "LD H, [HL]", &CPU::LD_H_HL };
-    instructions[0x67] = { "LD H, A", &CPU::LD_H_A };
-    instructions[0x68] = { "LD L, B", &CPU::LD_L_B };
-    instructions[0x69] = { "LD L, C", &CPU::LD_L_C };
-    instructions[0x6A] = { "LD L, D", &CPU::LD_L_D };
-    instructions[0x6B] = { "LD L, E", &CPU::LD_L_E };
-    instructions[0x6C] = { "LD L, H", &CPU::LD_L_H };
-    instructions[0x6D] = { "LD L, L", &CPU::LD_L_L };
-    instructions[0x6E] = { "LD L, [HL]", &CPU::LD_L_HL };
-    instructions[0x6F] = { "LD L, A", &CPU::LD_L_A };
-
-    // 0x70 - 0x7F
-    instructions[0x70] = { "LD (HL), B", &CPU::LD_at_HL_B };
-    instructions[0x71] = { "LD (HL), C", &CPU::LD_at_HL_C };
-    instructions[0x72] = { "LD (HL), D", &CPU::LD_at_HL_D };
-    instructions[0x73] = { "LD (HL), E", &CPU::LD_at_HL_E };
-    instructions[0x74] = { "LD (HL), H", &CPU::LD_at_HL_H };
-    instructions[0x75] = { "LD (HL), L", &CPU::LD_at_HL_L };
-    instructions[0x76] = { "HALT", &CPU::HALT };
-    instructions[0x77] = { "LD (HL), A", &CPU::LD_HL_ptr_A };
-    instructions[0x78] = { "LD A, B", &CPU::LD_A_B };
-    instructions[0x79] = { "LD A, C", &CPU::LD_A_C };
-    instructions[0x7A] = { "LD A, D", &CPU::LD_A_D };
-    instructions[0x7B] = { "LD A, E", &CPU::LD_A_E };
-    instructions[0x7C] = { "LD A, H", &CPU::LD_A_H };
-    instructions[0x7D] = { "LD A, L", &CPU::LD_A_L };
-    instructions[0x7E] = { "LD A, (HL)", &CPU::LD_A_HL_ptr };
-    instructions[0x7F] = { "LD A, A", &CPU::LD_A_A };
-
-    // 0x80 - 0x8F
-    instructions[0x80] = { "ADD A, B", &CPU::ADD_A_B };
-    instructions[0x81] = { "ADD A, C", &CPU::ADD_A_C };
-    instructions[0x82] = { "ADD A, D", &CPU::ADD_A_D };
-    instructions[0x83] = { "ADD A, E", &CPU::ADD_A_E };
-    instructions[0x84] = { "ADD A, H", &CPU::ADD_A_H };
-    instructions[0x85] = { "ADD A, L", &CPU::ADD_A_L };
-    instructions[0x86] = { "ADD A, [HL]", &CPU::ADD_A_HL };
-    instructions[0x87] = { "ADD A, A", &CPU::ADD_A_A };
-    instructions[0x88] = { "ADC A, B", &CPU::ADC_A_B };
-    instructions[0x89] = { "ADC A, C", &CPU::ADC_A_C };
-    instructions[0x8A] = { "ADC A, D", &CPU::ADC_A_D };
-    instructions[0x8B] = { "ADC A, E", &CPU::ADC_A_E };
-    instructions[0x8C] = { "ADC A, H", &CPU::ADC_A_H };
-    instructions[0x8D] = { "ADC A, L", &CPU::ADC_A_L };
-    instructions[0x8E] = { "ADC A, [HL]", &CPU::ADC_A_HL };
-    instructions[0x8F] = { "ADC A, A", &CPU::ADC_A_A };
-
-    // 0x90 - 0x9F
-    instructions[0x90] = { "SUB A, B", &CPU::SUB_A_B };
-    instructions[0x91] = { "SUB A, C", &CPU::SUB_A_C };
-    instructions[0x92] = { "SUB A, D", &CPU::SUB_A_D };
-    instructions[0x93] = { "SUB A, E", &CPU::SUB_A_E };
-    instructions[0x94] = { "SUB A, H", &CPU::SUB_A_H };
-    instructions[0x95] = { "SUB A, L", &CPU::SUB_A_L };
-    instructions[0x96] = { "SUB A, [HL]", &CPU::SUB_A_HL };
-    instructions[0x97] = { "SUB A, A", &CPU::SUB_A_A };
-    instructions[0x98] = { "SBC A, B", &CPU::SBC_A_B };
-    instructions[0x99] = { "SBC A, C", &CPU::SBC_A_C };
-    instructions[0x9A] = { "SBC A, D", &CPU::SBC_A_D };
-    instructions[0x9B] = { "SBC A, E", &CPU::SBC_A_E };
-    instructions[0x9C] = { "SBC A, H", &CPU::SBC_A_H };
-    instructions[0x9D] = { "SBC A, L", &CPU::SBC_A_L };
-    instructions[0x9E] = { "SBC A, [HL]", &CPU::SBC_A_HL };
-    instructions[0x9F] = { "SBC A, A", &CPU::SBC_A_A };
-    
-    // 0xA0 - 0xAF
-    instructions[0xA0] = { "AND A, B", &CPU::AND_A_B };
-    instructions[0xA1] = { "AND A, C", &CPU::AND_A_C };
-    instructions[0xA2] = { "AND A, D", &CPU::AND_A_D };
-    instructions[0xA3] = { "AND A, E", &CPU::AND_A_E };
-    instructions[0xA4] = { "AND A, H", &CPU::AND_A_H };
-    instructions[0xA5] = { "AND A, L", &CPU::AND_A_L };
-    instructions[0xA6] = { "AND A, [HL]", &CPU::AND_A_HL };
-    instructions[0xA7] = { "AND A, A", &CPU::AND_A_A };
-    instructions[0xA8] = { "XOR A, B", &CPU::XOR_A_B };
-    instructions[0xA9] = { "XOR A, C", &CPU::XOR_A_C };
-    instructions[0xAA] = { "XOR A, D", &CPU::XOR_A_D };
-    instructions[0xAB] = { "XOR A, E", &CPU::XOR_A_E };
-    instructions[0xAC] = { "XOR A, H", &CPU::XOR_A_H };
-    instructions[0xAD] = { "XOR A, L", &CPU::XOR_A_L };
-    instructions[0xAE] = { "XOR A, [HL]", &CPU::XOR_A_HL };
-    instructions[0xAF] = { "XOR A, A", &CPU::XOR_A_A };
-    
-    // 0xB0 - 0xBF
-    instructions[0xB0] = { "OR A, B", &CPU::OR_A_B };
-    instructions[0xB1] = { "OR A, C", &CPU::OR_A_C };
-    instructions[0xB2] = { "OR A, D", &CPU::OR_A_D };
-    instructions[0xB3] = { "OR A, E", &CPU::OR_A_E };
-    instructions[0xB4] = { "OR A, H", &CPU::OR_A_H };
-    instructions[0xB5] = { "OR A, L", &CPU::OR_A_L };
-    instructions[0xB6] = { "OR A, [HL]", &CPU::OR_A_HL };
-    instructions[0xB7] = { "OR A, A", &CPU::OR_A_A };
-    instructions[0xB8] = { "CP A, B", &CPU::CP_A_B };
-    instructions[0xB9] = { "CP A, C", &CPU::CP_A_C };
-    instructions[0xBA] = { "CP A, D", &CPU::CP_A_D };
-    instructions[0xBB] = { "CP A, E", &CPU::CP_A_E };
-    instructions[0xBC] = { "CP A, H", &CPU::CP_A_H };
-    instructions[0xBD] = { "CP A, L", &CPU::CP_A_L };
-    instructions[0xBE] = { "CP A, [HL]", &CPU::CP_at_HL };
-    instructions[0xBF] = { "CP A, A", &CPU::CP_A_A };
-
-    // 0xC0 - 0xCF
-    instructions[0xC0] = { "RET NZ", &CPU::RET_NZ };
-    instructions[0xC1] = { "POP BC", &CPU::POP_BC };
-    instructions[0xC2] = { "JP NZ, a16", &CPU::JP_NZ_a16 };
-    instructions[0xC3] = { "JP a16", &CPU::JP_a16 };
-    instructions[0xC4] = { "CALL NZ, a16", &CPU::CALL_NZ_a16 };
-    instructions[0xC5] = { "PUSH BC", &CPU::PUSH_BC };
-    instructions[0xC6] = { "ADD A, n8", &CPU::ADD_A_n8 };
-    instructions[0xC7] = { "RST 00H", &CPU::RST_00 };
-    instructions[0xC8] = { "RET Z", &CPU::RET_Z };
-    instructions[0xC9] = { "RET", &CPU::RET };
-    instructions[0xCA] = { "JP Z, a16", &CPU::JP_Z_a16 };
-    instructions[0xCB] = { "PREFIX CB", &CPU::PREFIX_CB };
-    instructions[0xCC] = { "CALL Z, a16", &CPU::CALL_Z_a16 };
-    instructions[0xCD] = { "CALL a16", &CPU::CALL_a16 };
-    instructions[0xCE] = { "ADC A, n8", &CPU::ADC_A_n8 };
-    instructions[0xCF] = { "RST 08H", &CPU::RST_08 };
-
-    // 0xD0 - 0xDF
-    instructions[0xD0] = { "RET NC", &CPU::RET_NC };
-    instructions[0xD1] = { "POP DE", &CPU::POP_DE };
-    instructions[0xD2] = { "JP NC, a16", &CPU::JP_NC_a16 };
-    instructions[0xD3] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xD4] = { "CALL NC, a16", &CPU::CALL_NC_a16 };
-    instructions[0xD5] = { "PUSH DE", &CPU::PUSH_DE };
-    instructions[0xD6] = { "SUB A, n8", &CPU::SUB_A_n8 };
-    instructions[0xD7] = { "RST 10H", &CPU::RST_10 };
-    instructions[0xD8] = { "RET C", &CPU::RET_C };
-    instructions[0xD9] = { "RETI", &CPU::RETI };
-    instructions[0xDA] = { "JP C, a16", &CPU::JP_C_a16 };
-    instructions[0xDB] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xDC] = { "CALL C, a16", &CPU::CALL_C_a16 };
-    instructions[0xDD] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xDE] = { "SBC A, n8", &CPU::SBC_A_n8 };
-    instructions[0xDF] = { "RST 18H", &CPU::RST_18 };
-
-    // 0xE0 - 0xEF
-    instructions[0xE0] = { "LDH [a8], A", &CPU::LDH_a8_a };
-    instructions[0xE1] = { "POP HL", &CPU::POP_HL };
-    instructions[0xE2] = { "LDH [C], A", &CPU::LDH_C_ptr_A };
-    instructions[0xE3] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xE4] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xE5] = { "PUSH HL", &CPU::PUSH_HL };
-    instructions[0xE6] = { "AND A, n8", &CPU::AND_A_n8 };
-    instructions[0xE7] = { "RST 20H", &CPU::RST_20 };
-    instructions[0xE8] = { "ADD SP, e8", &CPU::ADD_SP_e8 };
-    instructions[0xE9] = { "JP HL", &CPU::JP_HL };
-    instructions[0xEA] = { "LD [a16], A", &CPU::LD_a16_A };
-    instructions[0xEB] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xEC] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xED] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xEE] = { "XOR A, n8", &CPU::XOR_A_n8 };
-    instructions[0xEF] = { "RST 28H", &CPU::RST_28 };
-
-    // 0xF0 - 0xFF
-    instructions[0xF0] = { "LDH A, [a8]", &CPU::LDH_a_a8 };
-    instructions[0xF1] = { "POP AF", &CPU::POP_AF };
-    instructions[0xF2] = { "LDH A, [C]", &CPU::LDH_A_C_ptr };
-    instructions[0xF3] = { "DI", &CPU::DI };
-    instructions[0xF4] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xF5] = { "PUSH AF", &CPU::PUSH_AF };
-    instructions[0xF6] = { "OR A, n8", &CPU::OR_A_n8 };
-    instructions[0xF7] = { "RST 30H", &CPU::RST_30 };
-    instructions[0xF8] = { "LD HL, SP + e8", &CPU::LD_HL_SP_e8 };
-    instructions[0xF9] = { "LD SP, HL", &CPU::LD_SP_HL };
-    instructions[0xFA] = { "LD A, [a16]", &CPU::LD_A_a16_ptr };
-    instructions[0xFB] = { "EI", &CPU::EI };
-    instructions[0xFC] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xFD] = { "ILLEGAL", &CPU::ILLEGAL };
-    instructions[0xFE] = { "CP A, n8", &CPU::CP_A_n8 };
-    instructions[0xFF] = { "RST 38H", &CPU::RST_38 };
+#define CPU_OPCODE(op, name, fn, length, base_cycles) instructions[op] = { name, &CPU::fn };
+#include "cpu_opcodes.def"
 }
 
 uint8_t CPU::ILLEGAL() {
-    uint8_t opcode = mmu->read_byte(pc - 1);
-    std::stringstream ss;
-    ss << "Illegal opcode 0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(opcode)
-       << " at 0x" << (pc - 1);
-    throw std::runtime_error("[CPU] " + ss.str());
-    return 0;
+    raise_fault(Fault::FAULT_ILLEGAL_OPCODE, pc - 1);
+    return 4;
 }
 
 uint8_t CPU::XXX() {
-    uint8_t opcode = mmu->read_byte(pc - 1);
-    std::stringstream ss;
-    ss << "Unimplemented opcode 0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(opcode)
-       << " at 0x" << (pc - 1);
-    throw std::runtime_error("[CPU] " + ss.str());
-    return 0;
+    raise_fault(Fault::FAULT_UNIMPLEMENTED_OPCODE, pc - 1);
+    return 4;
 }
 
 uint8_t CPU::NOP() {
@@ -885,12 +1138,12 @@ uint8_t CPU::NOP() {
 }
 
 uint8_t CPU::JP_a16() {
-    pc = mmu->read_word(pc);
+    pc = read_imm16();
     return 16;
 }
 
 uint8_t CPU::JP_NZ_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     
     if (!get_flag_z()) {
         pc = address;
@@ -902,7 +1155,7 @@ uint8_t CPU::JP_NZ_a16() {
 }
 
 uint8_t CPU::JP_Z_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     
     if (get_flag_z()) {
         pc = address;
@@ -914,7 +1167,7 @@ uint8_t CPU::JP_Z_a16() {
 }
 
 uint8_t CPU::JP_NC_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     
     if (!get_flag_c()) {
         pc = address;
@@ -926,7 +1179,7 @@ uint8_t CPU::JP_NC_a16() {
 }
 
 uint8_t CPU::JP_C_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     
     if (get_flag_c()) {
         pc = address;
@@ -948,79 +1201,56 @@ uint8_t CPU::XOR_A_A() {
 
 uint8_t CPU::XOR_A_B() {
     a ^= b;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::XOR_A_C() {
     a ^= c;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::XOR_A_D() {
     a ^= d;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::XOR_A_E() {
     a ^= e;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::XOR_A_H() {
     a ^= h;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::XOR_A_L() {
     a ^= l;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::XOR_A_HL() {
     uint8_t value = mmu->read_byte(get_hl());
     a ^= value;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 8;
 }
 
 uint8_t CPU::XOR_A_n8() {
-    a ^= mmu->read_byte(pc++);
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    a ^= read_imm8();
+    pc++;
+    set_flags_result(a, 0x00);
     return 8;
 }
 
 uint8_t CPU::LD_A_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     a = value;
@@ -1028,7 +1258,7 @@ uint8_t CPU::LD_A_n8() {
 }
 
 uint8_t CPU::LD_B_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     b = value;
@@ -1036,7 +1266,7 @@ uint8_t CPU::LD_B_n8() {
 }
 
 uint8_t CPU::LD_C_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     c = value;
@@ -1044,7 +1274,7 @@ uint8_t CPU::LD_C_n8() {
 }
 
 uint8_t CPU::LD_D_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     d = value;
@@ -1052,7 +1282,7 @@ uint8_t CPU::LD_D_n8() {
 }
 
 uint8_t CPU::LD_E_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     e = value;
@@ -1060,7 +1290,7 @@ uint8_t CPU::LD_E_n8() {
 }
 
 uint8_t CPU::LD_H_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     h = value;
@@ -1068,7 +1298,7 @@ uint8_t CPU::LD_H_n8() {
 }
 
 uint8_t CPU::LD_L_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     l = value;
@@ -1076,7 +1306,7 @@ uint8_t CPU::LD_L_n8() {
 }
 
 uint8_t CPU::LD_HL_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     mmu->write_byte(get_hl(), value);
@@ -1084,37 +1314,25 @@ uint8_t CPU::LD_HL_n8() {
 }
 
 uint8_t CPU::DEC_A() {
-    // Set half-carry flag if lower nibble (bit 4) is 0
-    set_flag_h((a & 0x0F) == 0);
-
+    set_flags_dec(a);
     a--;
-    set_flag_z(a == 0);
-    set_flag_n(true);
     return 4;
 }
 
 uint8_t CPU::DEC_B() {
-    // Set half-carry flag if lower nibble (bit 4) is 0
-    set_flag_h((b & 0x0F) == 0);
-
+    set_flags_dec(b);
     b--;
-    set_flag_z(b == 0);
-    set_flag_n(true);
     return 4;
 }
 
 uint8_t CPU::DEC_C() {
-    // Set half-carry flag if lower nibble (bit 4) is 0
-    set_flag_h((c & 0x0F) == 0);
-
+    set_flags_dec(c);
     c--;
-    set_flag_z(c == 0);
-    set_flag_n(true);
     return 4;
 }
 
 uint8_t CPU::JR_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     pc += offset;
@@ -1122,7 +1340,7 @@ uint8_t CPU::JR_e8() {
 }
 
 uint8_t CPU::JR_NZ_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     if (!get_flag_z()) {
@@ -1148,7 +1366,7 @@ uint8_t CPU::EI() {
 // TODO: I/O specific instructions - needs proper impl later
 uint8_t CPU::LDH_a8_a() {
     // Get address offset
-    uint8_t offset = mmu->read_byte(pc);
+    uint8_t offset = read_imm8();
     pc++;
 
     // Write A to address 0xFF00 (beginning of I/O space) + offset
@@ -1160,7 +1378,7 @@ uint8_t CPU::LDH_a8_a() {
 
 uint8_t CPU::LDH_a_a8() {
     // Get address offset
-    uint8_t offset = mmu->read_byte(pc);
+    uint8_t offset = read_imm8();
     pc++;
 
     // Write value of address 0xFF00 (beginning of I/O space) + offset to register A
@@ -1171,116 +1389,55 @@ uint8_t CPU::LDH_a_a8() {
 }
 
 uint8_t CPU::CP_A_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-
-    // Set half-carry flag if lower nibble (bit 4) is 0
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);  
-
+    set_flags_sub(a, value, 0);
     return 8;
 }
 
 uint8_t CPU::CP_A_A() {
-    uint8_t value = a;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, a, 0);
     return 4;
 }
 
 uint8_t CPU::CP_A_B() {
-    uint8_t value = b;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, b, 0);
     return 4;
 }
 
 uint8_t CPU::CP_A_C() {
-    uint8_t value = c;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, c, 0);
     return 4;
 }
 
 uint8_t CPU::CP_A_D() {
-    uint8_t value = d;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, d, 0);
     return 4;
 }
 
 uint8_t CPU::CP_A_E() {
-    uint8_t value = e;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, e, 0);
     return 4;
 }
 
 uint8_t CPU::CP_A_H() {
-    uint8_t value = h;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, h, 0);
     return 4;
 }
 
 uint8_t CPU::CP_A_L() {
-    uint8_t value = l;
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-    set_flag_c(a < value);
+    set_flags_sub(a, l, 0);
     return 4;
 }
 
 uint8_t CPU::CP_at_HL() {
-    uint8_t value = mmu->read_byte(get_hl());
-    uint8_t result = a - value;
-
-    set_flag_z(result == 0);
-    set_flag_n(true);
-
-    // Set half-carry flag if lower nibble (bit 4) is 0
-    set_flag_h((a & 0x0F) < (value & 0x0F));
-
-    // Set carry value if A < value (unsigned)
-    set_flag_c(a < value);  
-
+    set_flags_sub(a, mmu->read_byte(get_hl()), 0);
     return 8;
 }
 
 uint8_t CPU::CALL_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     // Push current PC to stack
@@ -1294,7 +1451,7 @@ uint8_t CPU::CALL_a16() {
 }
 
 uint8_t CPU::CALL_NZ_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     if (!get_flag_z()) {
@@ -1311,7 +1468,7 @@ uint8_t CPU::CALL_NZ_a16() {
 }
 
 uint8_t CPU::CALL_Z_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     if (get_flag_z()) {
@@ -1328,7 +1485,7 @@ uint8_t CPU::CALL_Z_a16() {
 }
 
 uint8_t CPU::CALL_NC_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     if (!get_flag_c()) {
@@ -1345,7 +1502,7 @@ uint8_t CPU::CALL_NC_a16() {
 }
 
 uint8_t CPU::CALL_C_a16() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     if (get_flag_c()) {
@@ -1385,7 +1542,7 @@ uint8_t CPU::HALT() {
 }
 
 uint8_t CPU::LD_a16_A() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     mmu->write_byte(address, a);
@@ -1422,7 +1579,7 @@ uint8_t CPU::LD_HL_ptr_dec_A() {
 }
 
 uint8_t CPU::LD_a16_SP() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     mmu->write_word(address, sp);
@@ -1436,72 +1593,44 @@ uint8_t CPU::LDH_C_A() {
 }
 
 uint8_t CPU::INC_A() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((a & 0x0F) == 0x0F);
+    set_flags_inc(a);
     a++;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
     return 4;
 }
 
 uint8_t CPU::INC_B() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((b & 0x0F) == 0x0F);
+    set_flags_inc(b);
     b++;
-
-    set_flag_z(b == 0);
-    set_flag_n(false);
     return 4;
 }
 
 uint8_t CPU::INC_C() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((c & 0x0F) == 0x0F);
+    set_flags_inc(c);
     c++;
-
-    set_flag_z(c == 0);
-    set_flag_n(false);
     return 4;
 }
 
 uint8_t CPU::INC_D() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((d & 0x0F) == 0x0F);
+    set_flags_inc(d);
     d++;
-
-    set_flag_z(d == 0);
-    set_flag_n(false);
     return 4;
 }
 
 uint8_t CPU::INC_E() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((e & 0x0F) == 0x0F);
+    set_flags_inc(e);
     e++;
-
-    set_flag_z(e == 0);
-    set_flag_n(false);
     return 4;
 }
 
 uint8_t CPU::INC_H() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((h & 0x0F) == 0x0F);
+    set_flags_inc(h);
     h++;
-
-    set_flag_z(h == 0);
-    set_flag_n(false);
     return 4;
 }
 
 uint8_t CPU::INC_L() {
-    // Set half-carry flag if lower nibble (bit 4) is 0x0F before increment
-    set_flag_h((l & 0x0F) == 0x0F);
+    set_flags_inc(l);
     l++;
-
-    set_flag_z(l == 0);
-    set_flag_n(false);
     return 4;
 }
 
@@ -1509,20 +1638,15 @@ uint8_t CPU::INC_at_HL() {
     uint16_t address = get_hl();
     uint8_t value = mmu->read_byte(address);
 
-    // Half-carry: set if bit 3 overflows into bit 4
-    set_flag_h((value & 0x0F) == 0x0F);
+    set_flags_inc(value);
     value++;
 
-    set_flag_z(value == 0);
-    set_flag_n(false);
-
     mmu->write_byte(address, value);
-
     return 12;
 }
 
 uint8_t CPU::LD_BC_n16() {
-    uint16_t value = mmu->read_word(pc);
+    uint16_t value = read_imm16();
     pc += 2;
 
     set_bc(value);
@@ -1530,7 +1654,7 @@ uint8_t CPU::LD_BC_n16() {
 }
 
 uint8_t CPU::LD_DE_n16() {
-    uint16_t value = mmu->read_word(pc);
+    uint16_t value = read_imm16();
     pc += 2;
 
     set_de(value);
@@ -1538,7 +1662,7 @@ uint8_t CPU::LD_DE_n16() {
 }
 
 uint8_t CPU::LD_HL_n16() {
-    uint16_t value = mmu->read_word(pc);
+    uint16_t value = read_imm16();
     pc += 2;
 
     set_hl(value);
@@ -1546,7 +1670,7 @@ uint8_t CPU::LD_HL_n16() {
 }
 
 uint8_t CPU::LD_SP_n16() {
-    uint16_t value = mmu->read_word(pc);
+    uint16_t value = read_imm16();
     pc += 2;
 
     sp = value;
@@ -1580,34 +1704,26 @@ uint8_t CPU::DEC_SP() {
 }
 
 uint8_t CPU::DEC_D() {
-    set_flag_h((d & 0x0F) == 0);
+    set_flags_dec(d);
     d--;
-    set_flag_z(d == 0);
-    set_flag_n(true);
     return 4;
 }
 
 uint8_t CPU::DEC_E() {
-    set_flag_h((e & 0x0F) == 0);
+    set_flags_dec(e);
     e--;
-    set_flag_z(e == 0);
-    set_flag_n(true);
     return 4;
 }
 
 uint8_t CPU::DEC_H() {
-    set_flag_h((h & 0x0F) == 0);
+    set_flags_dec(h);
     h--;
-    set_flag_z(h == 0);
-    set_flag_n(true);
     return 4;
 }
 
 uint8_t CPU::DEC_L() {
-    set_flag_h((l & 0x0F) == 0);
+    set_flags_dec(l);
     l--;
-    set_flag_z(l == 0);
-    set_flag_n(true);
     return 4;
 }
 
@@ -1615,10 +1731,8 @@ uint8_t CPU::DEC_at_HL() {
     uint16_t address = get_hl();
     uint8_t value = mmu->read_byte(address);
 
-    set_flag_h((value & 0x0F) == 0);
+    set_flags_dec(value);
     value--;
-    set_flag_z(value == 0);
-    set_flag_n(true);
 
     mmu->write_byte(address, value);
     return 12;
@@ -1661,86 +1775,59 @@ uint8_t CPU::LD_A_A() {
 
 uint8_t CPU::OR_A_A() {
     a |= a;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
 
     return 4;
 }
 
 uint8_t CPU::OR_A_B() {
     a |= b;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::OR_A_C() {
     a |= c;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::OR_A_D() {
     a |= d;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::OR_A_E() {
     a |= e;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::OR_A_H() {
     a |= h;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::OR_A_L() {
     a |= l;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 4;
 }
 
 uint8_t CPU::OR_A_HL() {
     a |= mmu->read_byte(get_hl());
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
     return 8;
 }
 
 uint8_t CPU::OR_A_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     a |= value;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(false);
-    set_flag_c(false);
+    set_flags_result(a, 0x00);
 
     return 8;
 }
@@ -1771,82 +1858,58 @@ uint8_t CPU::PUSH_HL() {
 
 uint8_t CPU::AND_A_A() {
     a &= a;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_B() {
     a &= b;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_C() {
     a &= c;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_D() {
     a &= d;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_E() {
     a &= e;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_H() {
     a &= h;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_L() {
     a &= l;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 4;
 }
 
 uint8_t CPU::AND_A_n8() {
-    uint8_t value = mmu->read_byte(pc);
+    uint8_t value = read_imm8();
     pc++;
 
     a &= value;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
 
     return 8;
 }
 
 uint8_t CPU::JR_Z_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     if (get_flag_z()) {
@@ -1858,7 +1921,7 @@ uint8_t CPU::JR_Z_e8() {
 }
 
 uint8_t CPU::JR_C_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     if (get_flag_c()) {
@@ -1870,7 +1933,7 @@ uint8_t CPU::JR_C_e8() {
 }
 
 uint8_t CPU::JR_NC_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     if (!get_flag_c()) {
@@ -1943,7 +2006,7 @@ uint8_t CPU::LD_A_HL_ptr() {
 }
 
 uint8_t CPU::LD_A_a16_ptr() {
-    uint16_t address = mmu->read_word(pc);
+    uint16_t address = read_imm16();
     pc += 2;
 
     a = mmu->read_byte(address);
@@ -2001,7 +2064,7 @@ uint8_t CPU::CPL() {
 }
 
 uint8_t CPU::PREFIX_CB() {
-    uint8_t cb_opcode = mmu->read_byte(pc);
+    uint8_t cb_opcode = read_imm8();
     pc++;
 
     // Execute the instruction from the CB-specific table
@@ -2208,121 +2271,37 @@ uint8_t CPU::RST_38() {
 }
 
 uint8_t CPU::ADD_A_A() {
-    uint8_t val = a; // Adding A to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(a, false);
     return 4;
 }
 
 uint8_t CPU::ADD_A_B() {
-    uint8_t val = b; // Adding B to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(b, false);
     return 4;
 }
 
 uint8_t CPU::ADD_A_C() {
-    uint8_t val = c; // Adding C to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(c, false);
     return 4;
 }
 
 uint8_t CPU::ADD_A_D() {
-    uint8_t val = d; // Adding D to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(d, false);
     return 4;
 }
 
 uint8_t CPU::ADD_A_E() {
-    uint8_t val = e; // Adding E to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(e, false);
     return 4;
 }
 
 uint8_t CPU::ADD_A_H() {
-    uint8_t val = h; // Adding D to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(h, false);
     return 4;
 }
 
 uint8_t CPU::ADD_A_L() {
-    uint8_t val = l; // Adding L to A
-    
-    // Half-carry - Carry from bit 3 to bit 4
-    set_flag_h(((a & 0x0F) + (val & 0x0F)) > 0x0F);
-    
-    // Carry - Carry from bit 7 (result > 0xFF)
-    set_flag_c((static_cast<uint16_t>(a) + static_cast<uint16_t>(val)) > 0xFF);
-
-    a += val;
-
-    set_flag_z(a == 0);
-    set_flag_n(false);
-
+    alu_add(l, false);
     return 4;
 }
 
@@ -2458,40 +2437,21 @@ uint8_t CPU::CCF() {
 }
 
 void CPU::alu_add(uint8_t val, bool carry) {
-    uint16_t c = carry ? 1 : 0;
-    uint16_t result = a + val + c;
-    
-    set_flag_z((result & 0xFF) == 0);
-    set_flag_n(false);
-    // Half-carry: overflow from bit 3
-    set_flag_h(((a & 0x0F) + (val & 0x0F) + c) > 0x0F);
-    // Carry: overflow from bit 7
-    set_flag_c(result > 0xFF);
-    
-    a = static_cast<uint8_t>(result);
+    uint8_t c = carry ? 1 : 0;
+    set_flags_add(a, val, c);
+    a = static_cast<uint8_t>(a + val + c);
 }
 
 void CPU::alu_sub(uint8_t val, bool carry) {
-    uint16_t c = carry ? 1 : 0;
-    int16_t result = a - val - c;
-    
-    set_flag_z((result & 0xFF) == 0);
-    set_flag_n(true);
-    // Half-carry: borrow from bit 4
-    set_flag_h(((a & 0x0F) - (val & 0x0F) - c) < 0);
-    // Carry: borrow from bit 8 (result < 0)
-    set_flag_c(result < 0);
-    
-    a = static_cast<uint8_t>(result);
+    uint8_t c = carry ? 1 : 0;
+    set_flags_sub(a, val, c);
+    a = static_cast<uint8_t>(a - val - c);
 }
 
 uint8_t CPU::AND_A_HL() {
     uint8_t val = mmu->read_byte(get_hl());
     a &= val;
-    set_flag_z(a == 0);
-    set_flag_n(false);
-    set_flag_h(true);
-    set_flag_c(false);
+    set_flags_result(a, 0x20);
     return 8;
 }
 
@@ -2501,7 +2461,8 @@ uint8_t CPU::ADD_A_HL() {
 }
 
 uint8_t CPU::ADD_A_n8() {
-    alu_add(mmu->read_byte(pc++), false);
+    alu_add(read_imm8(), false);
+    pc++;
     return 8;
 }
 
@@ -2513,7 +2474,7 @@ uint8_t CPU::ADC_A_E() { alu_add(e, get_flag_c()); return 4; }
 uint8_t CPU::ADC_A_H() { alu_add(h, get_flag_c()); return 4; }
 uint8_t CPU::ADC_A_L() { alu_add(l, get_flag_c()); return 4; }
 uint8_t CPU::ADC_A_HL() { alu_add(mmu->read_byte(get_hl()), get_flag_c()); return 8; }
-uint8_t CPU::ADC_A_n8() { alu_add(mmu->read_byte(pc++), get_flag_c()); return 8; }
+uint8_t CPU::ADC_A_n8() { alu_add(read_imm8(), get_flag_c()); pc++; return 8; }
 
 uint8_t CPU::SUB_A_A() { alu_sub(a, false); return 4; }
 uint8_t CPU::SUB_A_B() { alu_sub(b, false); return 4; }
@@ -2523,7 +2484,7 @@ uint8_t CPU::SUB_A_E() { alu_sub(e, false); return 4; }
 uint8_t CPU::SUB_A_H() { alu_sub(h, false); return 4; }
 uint8_t CPU::SUB_A_L() { alu_sub(l, false); return 4; }
 uint8_t CPU::SUB_A_HL() { alu_sub(mmu->read_byte(get_hl()), false); return 8; }
-uint8_t CPU::SUB_A_n8() { alu_sub(mmu->read_byte(pc++), false); return 8; }
+uint8_t CPU::SUB_A_n8() { alu_sub(read_imm8(), false); pc++; return 8; }
 
 uint8_t CPU::SBC_A_A() { alu_sub(a, get_flag_c()); return 4; }
 uint8_t CPU::SBC_A_B() { alu_sub(b, get_flag_c()); return 4; }
@@ -2533,7 +2494,7 @@ uint8_t CPU::SBC_A_E() { alu_sub(e, get_flag_c()); return 4; }
 uint8_t CPU::SBC_A_H() { alu_sub(h, get_flag_c()); return 4; }
 uint8_t CPU::SBC_A_L() { alu_sub(l, get_flag_c()); return 4; }
 uint8_t CPU::SBC_A_HL() { alu_sub(mmu->read_byte(get_hl()), get_flag_c()); return 8; }
-uint8_t CPU::SBC_A_n8() { alu_sub(mmu->read_byte(pc++), get_flag_c()); return 8; }
+uint8_t CPU::SBC_A_n8() { alu_sub(read_imm8(), get_flag_c()); pc++; return 8; }
 
 uint8_t CPU::LD_L_A() {
     l = a;
@@ -2764,7 +2725,7 @@ uint8_t CPU::LD_SP_HL() {
 }
 
 uint8_t CPU::ADD_SP_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     // Flags based on unsigned addition of lower 8 bits
@@ -2779,7 +2740,7 @@ uint8_t CPU::ADD_SP_e8() {
 }
 
 uint8_t CPU::STOP() {
-    uint8_t next_byte = mmu->read_byte(pc);
+    uint8_t next_byte = read_imm8();
     pc++;
     
     stopped = true;
@@ -2787,7 +2748,7 @@ uint8_t CPU::STOP() {
 }
 
 uint8_t CPU::LD_HL_SP_e8() {
-    int8_t offset = static_cast<int8_t>(mmu->read_byte(pc));
+    int8_t offset = static_cast<int8_t>(read_imm8());
     pc++;
 
     set_flag_z(false);
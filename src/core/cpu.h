@@ -3,7 +3,22 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <memory>
+#include <utility>
 #include "mmu.h"
+#include "block_cache.h"
+#include "scheduler.h"
+#include "interrupts.h"
+#include "fault.h"
+
+#ifdef GAMEBYTE_JIT
+#include "jit.h"
+#endif
+
+// Use GCC/Clang computed goto ("labels as values") for the threaded interpreter loop where available
+#if !defined(GAMEBYTE_LEGACY_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define GAMEBYTE_COMPUTED_GOTO 1
+#endif
 
 /**
  * @brief Emulates the Game Boy's CPU, specifically the Sharp SM83.
@@ -31,6 +46,7 @@ class CPU {
         // External modules
         MMU* mmu = nullptr;
         uint32_t total_cycles = 0;
+        uint64_t total_instructions = 0;
 
         // Instruction handling
         struct Instruction {
@@ -44,8 +60,49 @@ class CPU {
         uint8_t a, b, c, d, e, h, l;
 
         // Flag register
+        // Only up to date once materialize_flags() has run - use get_f() to read it
         uint8_t f;
 
+        // Arithmetic instructions record their operands here instead of computing Z/N/H/C straight away
+        // The flags are only worked out when something reads them (a conditional jump, PUSH AF, DAA, get_af()...)
+        enum FlagOperation : uint8_t {
+            FLAGS_NONE,     // f holds the real flags
+            FLAGS_ADD,      // lhs + rhs + extra (carry in)
+            FLAGS_SUB,      // lhs - rhs - extra (carry in)
+            FLAGS_INC,      // lhs + 1, extra holds the untouched C flag
+            FLAGS_DEC,      // lhs - 1, extra holds the untouched C flag
+            FLAGS_RESULT    // Z from lhs, extra holds N, H and C
+        };
+
+        struct LazyFlags {
+            FlagOperation op = FLAGS_NONE;
+            uint8_t lhs = 0;
+            uint8_t rhs = 0;
+            uint8_t extra = 0;
+        };
+
+        LazyFlags lazy_flags;
+
+        // Work out the flag register from a recorded operation
+        static uint8_t evaluate_flags(const LazyFlags& flags);
+
+        // Work out only C (0x10 or 0) from a recorded operation
+        static uint8_t evaluate_carry(const LazyFlags& flags);
+
+        // Current value of the flag register
+        uint8_t get_f() const { return lazy_flags.op == FLAGS_NONE ? f : evaluate_flags(lazy_flags); }
+
+        // Current carry flag as 0x10 or 0, without evaluating Z, N and H
+        uint8_t get_carry() const { return lazy_flags.op == FLAGS_NONE ? (f & 0x10) : evaluate_carry(lazy_flags); }
+
+        // Write any pending flags back to f
+        void materialize_flags() {
+            if (lazy_flags.op != FLAGS_NONE) {
+                f = evaluate_flags(lazy_flags);
+                lazy_flags.op = FLAGS_NONE;
+            }
+        }
+
         // 16-bit registers
         uint16_t sp; // Stack pointer
         uint16_t pc; // Program counter
@@ -67,8 +124,10 @@ class CPU {
         struct InstructionLog {
             uint16_t pc;
             uint8_t opcode;
+            uint8_t operand;  // First operand byte - the extended opcode for 0xCB
             uint8_t a, b, c, d, e, h, l, f;
             uint16_t sp;
+            LazyFlags flags;  // f is only valid after evaluating these
         };
 
         static const size_t HISTORY_SIZE = 100;
@@ -79,6 +138,37 @@ class CPU {
         void log_instruction(uint8_t opcode);
         void dump_history();
 
+        // Accesses caught by MMU watchpoints
+        struct WatchHit {
+            uint16_t pc;        // Instruction that made the access
+            uint16_t address;
+            uint8_t value;      // Byte read, written or fetched
+            uint8_t kind;       // MMU::WatchKind
+            uint64_t cycle;
+        };
+
+        static const size_t WATCH_HISTORY_SIZE = 100;
+        std::array<WatchHit, WATCH_HISTORY_SIZE> watch_hits;
+        size_t watch_hits_pos = 0;
+        bool watch_hits_wrapped = false;
+
+        // Set by a pausing watchpoint - GameBoy::run_frame() stops after the instruction, clear it to carry on
+        bool watch_paused = false;
+
+        void record_watch_hit(uint8_t kind, uint16_t address, uint8_t value);
+        void dump_watch_hits();
+
+        // Last fault raised, and what to do about the next one (see FaultPolicy)
+        Fault fault;
+        FaultPolicy fault_policy = FAULT_POLICY_HALT;
+
+        // Set by a fault under FAULT_POLICY_HALT - step() and run() do nothing until clear_fault() is called
+        bool fault_halted = false;
+
+        // Record a fault at the current instruction and apply the policy - never allocates
+        void raise_fault(Fault::Type type, uint16_t address);
+        void clear_fault();
+
         // Constructor
         CPU();
 
@@ -106,37 +196,92 @@ class CPU {
         bool get_flag_c() const;
         void set_flag_c(bool value);
 
-        // Connect an initialized MMU to the CPU
+        // Connect an initialized MMU to the CPU, and take over the timer registers ($FF04-$FF07)
         void connect_mmu(MMU* mmu);
 
+        // IF/IE - checked before every instruction
+        InterruptController* interrupts = nullptr;
+        void connect_interrupts(InterruptController* i);
+
+        // Master clock the timers are kept in step with (without one, only tick_timers() moves them)
+        Scheduler* scheduler = nullptr;
+        void connect_scheduler(Scheduler* s);
+
+        // Bring the timers up to the scheduler's clock - done before DIV/TIMA are read or a timer register is written
+        void catch_up_timers();
+
+        // Schedule EVENT_TIMER for the next TIMA overflow (or the end of a pending reload)
+        void schedule_timer_event();
+
         // Tick internal CPU timers based on cycles passed
-        void tick_timers(uint8_t cycles);
+        // TIMA increments, overflows and the TMA reload delay are all worked out arithmetically from the span
+        void tick_timers(uint32_t cycles);
+
+        // Cycles until TIMA overflows (the timer's only interrupt), UINT32_MAX while the timer is disabled
+        // Returns 0 while a TMA reload is pending
+        uint32_t cycles_until_timer_overflow() const;
 
         // Reset internal counter
         void reset_internal_counter();
 
-        // Timer sync helpers, called by MMU on writes to timer registers
+        // CPU accesses to the timer registers ($FF00 + reg) - the timers catch up to the current cycle first, and
+        // writes reschedule the next overflow
+        uint8_t read_timer_register(uint8_t reg);
+        void write_timer_register(uint8_t reg, uint8_t value);
+
+        // Timer sync helpers, called on writes to timer registers
         void sync_timer_on_div_write();
         void sync_timer_on_tac_write(uint8_t new_tac);
         void sync_timer_on_tma_write(uint8_t value);
         void sync_timer_on_tima_write(uint8_t value);
 
         // Interrupt handlers
+        // handle_interrupts() is a single load and branch unless an enabled interrupt is requested
         uint8_t handle_interrupts();
         uint8_t execute_interrupt(uint8_t bit, uint16_t vector);
 
-        // Execute the next instruction
-        // Returns the number of cycles consumed
+        // Execute the next instruction (or cached block), moving the scheduler's clock along with it
+        // Returns the number of cycles consumed - check Scheduler::is_due() afterwards
         uint8_t step();
 
+        // Pre-decoded basic block cache (off by default)
+        BlockCache block_cache;
+        bool block_cache_enabled = false;
+        void set_block_cache_enabled(bool enabled);
+
+        // Compile hot blocks to host code (turns the block cache on as well)
+        // Throws if this build has no JIT
+        void set_jit_enabled(bool enabled);
+        bool is_jit_enabled() const;
+
+        // Called by the MMU when a write may have changed the code the CPU is running
+        // (an MBC bank switch, or a RAM byte that belongs to a cached block)
+        void notify_code_write(uint16_t address);
+        void notify_rom_bank_change();
+
+        // Called by the MMU when an OAM DMA transfer takes over the bus - cached blocks can't see bus conflicts, so
+        // the block being run ends here and instructions are interpreted until the transfer is done
+        void notify_dma_start();
+
+        // Execute a single already-fetched opcode through the interpreter dispatch
+        // Returns the number of cycles consumed
+        uint8_t execute(uint8_t opcode);
+
+        // Interpret instructions back-to-back until at least cycle_budget cycles have been consumed, moving the
+        // master clock like step() does. Stops early once a scheduler event is due, the CPU halts or faults, or in
+        // front of an LDH A,(LY) or LDH A,(STAT) - the caller runs the events and looks for an idle loop before
+        // calling again
+        // Ignores the block cache; returns the number of cycles consumed
+        uint32_t run(uint32_t cycle_budget);
+
         // Debug the status of interupts
         void debug_interrupt_status();
 
         // Implement extended opcodes (0xCB prefix)
         uint8_t execute_cb_instruction(uint8_t opcode);
 
-        // Handle carry flag for CB instructions
-        uint8_t handle_cb_shift_rotate(uint8_t opcode, uint8_t value);
+        // Extended opcode mnemonics for dump_history (generated at compile time) - dispatch is a switch over CB_OP below
+        static const std::array<const char*, 256> cb_instructions;
 
         // Initialize instruction table for opcode handling
         void init_instructions();
@@ -671,12 +816,69 @@ class CPU {
         // Add signed 8-bit immediate to stack pointer and store result in HL (0xF8)
         uint8_t LD_HL_SP_e8();
     private:
+        // Extended (0xCB) opcode - the operation, bit and register are all decoded from the template argument
+        template <uint8_t opcode>
+        uint8_t CB_OP();
+
+        template <size_t... opcodes>
+        static constexpr std::array<const char*, 256> make_cb_instructions(std::index_sequence<opcodes...>);
+
+        // Operand bytes of the instruction being executed, prefetched before its handler runs
+        uint8_t operands[2] = {};
+
+        uint8_t read_imm8() const { return operands[0]; }
+        uint16_t read_imm16() const { return operands[0] | (operands[1] << 8); }
+
+        // Address of the instruction being executed, set by every dispatch path (compiled blocks only before they
+        // call out to the MMU or an interpreter handler) - faults and watchpoint hits are reported at it
+        uint16_t instruction_pc = 0;
+
+        // Fetch the opcode at PC and prefetch its operand bytes
+        uint8_t fetch_instruction();
+
+        // Set when the code of the block being executed may have changed under it
+        bool block_aborted = false;
+
+        // Count cycles the CPU has spent and move the master clock by as many
+        // Returns true if an event has come due
+        bool spend_cycles(uint32_t cycles) {
+            total_cycles += cycles;
+            return scheduler && scheduler->advance(cycles);
+        }
+
+        // Whether the fetched LDH A,(n8) reads LY or STAT, which is how every busy-wait loop starts
+        bool is_idle_poll() const { return operands[0] == 0x44 || operands[0] == 0x41; }
+
+        // Execute the cached block at PC, decoding it first on a miss
+        uint8_t execute_block();
+
+        // Scratch block for code that can't be cached (VRAM, external RAM, OAM, I/O)
+        BlockCache::Block uncached_block;
+
+        // Decode the straight-line run of instructions at PC into the block cache
+        BlockCache::Block* decode_block(uint16_t bank);
+
+#ifdef GAMEBYTE_JIT
+        // Compiled code works on the registers directly
+        friend class JIT;
+        std::unique_ptr<JIT> jit;
+#endif
+
         // Helper to get state of the timer multiplexer
         bool get_timer_enable_bit(uint16_t counter, uint8_t tac);
+
+        // Cycles between two TIMA increments for the frequency selected in TAC
+        static uint16_t get_timer_period(uint8_t tac);
+
+        // TIMA increment caused by a DIV or TAC write, including the overflow into a reload
+        void increment_tima();
     
         // State of TIMA reload delay (4 cycles)
         int tima_reload_delay = 0;
 
+        // Scheduler cycle the timers have been advanced to
+        uint64_t timers_cycle = 0;
+
         // Performs addition (ADD/ADC) and updates flags
         // carry: if true, adds the C flag to the sum
         void alu_add(uint8_t val, bool carry);
@@ -684,4 +886,11 @@ class CPU {
         // Helper: Performs Subtraction (SUB/SBC) and updates flags
         // carry: if true, subtracts the C flag from the result
         void alu_sub(uint8_t val, bool carry);
+
+        // Record the operation behind the next flag value
+        void set_flags_add(uint8_t lhs, uint8_t rhs, uint8_t carry) { lazy_flags = { FLAGS_ADD, lhs, rhs, carry }; }
+        void set_flags_sub(uint8_t lhs, uint8_t rhs, uint8_t carry) { lazy_flags = { FLAGS_SUB, lhs, rhs, carry }; }
+        void set_flags_inc(uint8_t old_value) { lazy_flags = { FLAGS_INC, old_value, 0, get_carry() }; }
+        void set_flags_dec(uint8_t old_value) { lazy_flags = { FLAGS_DEC, old_value, 0, get_carry() }; }
+        void set_flags_result(uint8_t result, uint8_t nhc) { lazy_flags = { FLAGS_RESULT, result, 0, nhc }; }
 };
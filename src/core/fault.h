@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Something the emulated program did that real hardware has no sensible answer to.
+ *
+ * Faults are raised on the emulation hot path (the MMU's slow path and the opcode handlers), so they are a plain
+ * status instead of an exception - raising one never allocates, and a bad ROM can't take the whole process down.
+ * What happens next is up to the CPU's FaultPolicy; unless it is FAULT_POLICY_IGNORE, the last fault is kept in
+ * CPU::fault.
+ */
+struct Fault {
+    enum Type : uint8_t {
+        FAULT_NONE,
+        FAULT_UNUSABLE_READ,        // $FEA0-$FEFF
+        FAULT_UNUSABLE_WRITE,
+        FAULT_ILLEGAL_OPCODE,       // One of the 11 holes in the opcode table - locks up a real CPU
+        FAULT_UNIMPLEMENTED_OPCODE
+    };
+
+    Type type = FAULT_NONE;
+    uint16_t pc = 0;        // Instruction that caused it (CPU::instruction_pc)
+    uint16_t address = 0;   // Address accessed, or of the opcode
+    uint64_t cycle = 0;
+
+    static const char* describe(Type type) {
+        switch (type) {
+            case FAULT_UNUSABLE_READ: return "Read of unusable memory area";
+            case FAULT_UNUSABLE_WRITE: return "Write to unusable memory area";
+            case FAULT_ILLEGAL_OPCODE: return "Illegal opcode";
+            case FAULT_UNIMPLEMENTED_OPCODE: return "Unimplemented opcode";
+            default: return "No fault";
+        }
+    }
+};
+
+// What the CPU does about a fault - in every case an unusable read returns $FF, an unusable write is dropped and a
+// bad opcode takes 4 cycles and does nothing
+enum FaultPolicy : uint8_t {
+    FAULT_POLICY_HALT,      // Record it and stop: GameBoy::run_frame() returns early and the CPU runs no further
+    FAULT_POLICY_LOG,       // Record it, print it and carry on
+    FAULT_POLICY_IGNORE     // Carry on as if nothing happened - CPU::fault isn't touched
+};
@@ -0,0 +1,223 @@
+#include "gameboy.h"
+#include <algorithm>
+
+GameBoy::GameBoy() {
+    // Base components and connections
+    mmu.connect_interrupts(&interrupts);
+    cpu.connect_interrupts(&interrupts);
+    ppu.connect_interrupts(&interrupts);
+    ppu.connect_mmu(&mmu);
+    mmu.connect_ppu(&ppu);
+    cpu.connect_mmu(&mmu);
+    mmu.connect_cpu(&cpu);
+    joypad.connect_mmu(&mmu);
+
+    // Everything above runs before the clock starts
+    cpu.connect_scheduler(&scheduler);
+    ppu.connect_scheduler(&scheduler);
+    mmu.connect_scheduler(&scheduler);
+}
+
+bool GameBoy::load_rom(const char* filename) {
+    std::shared_ptr<const ROM> rom = ROM::open(filename);
+    if (!rom) {
+        return false;
+    }
+
+    return load_rom(std::move(rom));
+}
+
+bool GameBoy::load_rom(std::shared_ptr<const ROM> rom) {
+    return mmu.load_game(std::move(rom));
+}
+
+bool GameBoy::load_save(const char* filename) {
+    if (!mmu.load_save(filename)) {
+        return false;
+    }
+
+    scheduler.schedule(Scheduler::EVENT_SAVE, scheduler.get_cycle() + SAVE_FLUSH_FRAMES * CYCLES_PER_FRAME);
+    return true;
+}
+
+uint8_t GameBoy::step() {
+    // The CPU moves the clock itself, one instruction at a time even inside a block
+    uint8_t cycles = cpu.step();
+
+    if (scheduler.is_due()) {
+        run_events();
+    }
+
+    return cycles;
+}
+
+void GameBoy::run_events() {
+    Scheduler::Event event;
+
+    while (scheduler.pop_due(event)) {
+        switch (event) {
+            case Scheduler::EVENT_PPU:
+                ppu.sync();
+                break;
+
+            case Scheduler::EVENT_TIMER:
+                cpu.catch_up_timers();
+                cpu.schedule_timer_event();
+                break;
+
+            case Scheduler::EVENT_JOYPAD:
+                apply_queued_inputs();
+                break;
+
+            case Scheduler::EVENT_DMA:
+                mmu.finish_dma();
+                break;
+
+            case Scheduler::EVENT_SAVE:
+                mmu.flush_save();
+                scheduler.schedule(Scheduler::EVENT_SAVE, scheduler.get_cycle() + SAVE_FLUSH_FRAMES * CYCLES_PER_FRAME);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+uint32_t GameBoy::advance(uint32_t max_cycles) {
+    // The whole machine stands still after a halting fault, not just the CPU
+    if (cpu.fault_halted) return 0;
+
+    uint16_t pc = cpu.pc;
+    bool repeated = (recent_pcs[recent_index] == pc);
+    recent_pcs[recent_index] = pc;
+    recent_index = (recent_index + 1) % 3;
+
+    if (cpu.halted || cpu.stopped || repeated) {
+        uint32_t cycles = skip_idle(max_cycles);
+        if (cycles > 0) return cycles;
+    }
+
+    // Without the block cache, run the threaded interpreter until the next event instead of one instruction
+    // Watchpoints can pause the CPU after any instruction, so they keep it stepping
+    if (!cpu.block_cache_enabled && !mmu.requires_interpreter()) {
+        uint32_t cycles = cpu.run(max_cycles);
+
+        if (scheduler.is_due()) {
+            run_events();
+        }
+
+        return cycles;
+    }
+
+    return step();
+}
+
+uint32_t GameBoy::skip_idle(uint32_t max_cycles) {
+    uint16_t pc = cpu.pc;
+    bool halted = cpu.halted || cpu.stopped;
+
+    // The loop check reads memory, which watchpoints would see
+    if (!halted && (mmu.requires_interpreter() || mmu.read_byte(pc) != 0xF0)) return 0;
+
+    // Same test CPU::handle_interrupts() uses to wake up
+    uint8_t pending = interrupts.get_pending();
+
+    uint64_t now = scheduler.get_cycle();
+    uint64_t deadline = scheduler.get_next_deadline();
+    uint32_t distance = (deadline > now) ? static_cast<uint32_t>(std::min<uint64_t>(deadline - now, max_cycles)) : 0;
+
+    if (halted) {
+        if (pending) return 0;
+
+        // A halted CPU idles in 4-cycle steps, so the wake-up is seen at the end of the step the event falls in
+        uint32_t cycles = (distance + 3) & ~3u;
+        if (cycles <= 4) return 0;
+
+        cpu.total_cycles += cycles;
+        if (scheduler.advance(cycles)) {
+            run_events();
+        }
+        return cycles;
+    }
+
+    // Busy-wait on LY or STAT: LDH A,(n8) ; CP n8 / AND n8 ; JR cc,<the LDH>
+    // The loop only reads registers that can't change before the next event, so whole iterations can be skipped
+    if (pc >= 0xFE00 - 6 && pc < 0xFF80) return 0;
+    if (cpu.ime_delay > 0 || (cpu.ime && pending)) return 0;
+
+    uint8_t port = mmu.read_byte(pc + 1);
+    uint8_t test = mmu.read_byte(pc + 2);
+    uint8_t operand = mmu.read_byte(pc + 3);
+    uint8_t jump = mmu.read_byte(pc + 4);
+    uint8_t offset = mmu.read_byte(pc + 5);
+
+    if ((port != 0x44 && port != 0x41) || (test != 0xFE && test != 0xE6) || (jump & 0xE7) != 0x20 || offset != 0xFA) {
+        return 0;
+    }
+
+    // LDH (12) + CP/AND (8) + JR taken (12)
+    const uint32_t ITERATION_CYCLES = 32;
+    uint32_t iterations = distance / ITERATION_CYCLES;
+    if (iterations == 0) return 0;
+
+    // Only skip if the loop keeps going - the registers read back the same on every iteration until the event
+    uint8_t value = mmu.read_byte(0xFF00 | port);
+    uint8_t a = (test == 0xFE) ? value : (value & operand);
+    uint8_t f = (test == 0xFE) ? CPU::evaluate_flags({ CPU::FLAGS_SUB, value, operand, 0 })
+                               : CPU::evaluate_flags({ CPU::FLAGS_RESULT, a, 0, 0x20 });
+
+    // JR NZ, Z, NC, C
+    static const uint8_t CONDITION_MASKS[4] = { 0x80, 0x80, 0x10, 0x10 };
+    bool flag_set = (f & CONDITION_MASKS[(jump >> 3) & 0x03]) != 0;
+    bool taken = (jump & 0x08) ? flag_set : !flag_set;
+    if (!taken) return 0;
+
+    uint32_t cycles = iterations * ITERATION_CYCLES;
+    cpu.set_af(static_cast<uint16_t>((a << 8) | f));
+    cpu.total_cycles += cycles;
+    cpu.total_instructions += iterations * 3;
+    if (scheduler.advance(cycles)) {
+        run_events();
+    }
+    return cycles;
+}
+
+uint32_t GameBoy::run_frame() {
+    uint32_t cycles_this_frame = 0;
+
+    while (cycles_this_frame < CYCLES_PER_FRAME && !cpu.watch_paused && !cpu.fault_halted) {
+        cycles_this_frame += advance(CYCLES_PER_FRAME - cycles_this_frame);
+    }
+
+    return cycles_this_frame;
+}
+
+void GameBoy::set_button(Joypad::Button button, bool pressed) {
+    if (joypad.set_button(button, pressed)) {
+        // Request Joypad Interrupt (bit 4 of IF register)
+        interrupts.request(InterruptController::INT_JOYPAD);
+    }
+}
+
+void GameBoy::queue_button(Joypad::Button button, bool pressed, uint64_t cycle) {
+    // Keep inputs for the same cycle in the order they were queued
+    auto position = std::upper_bound(queued_inputs.begin(), queued_inputs.end(), cycle,
+                                     [](uint64_t c, const QueuedInput& input) { return c < input.cycle; });
+    queued_inputs.insert(position, { cycle, button, pressed });
+
+    scheduler.schedule(Scheduler::EVENT_JOYPAD, queued_inputs.front().cycle);
+}
+
+void GameBoy::apply_queued_inputs() {
+    size_t applied = 0;
+    while (applied < queued_inputs.size() && queued_inputs[applied].cycle <= scheduler.get_cycle()) {
+        set_button(queued_inputs[applied].button, queued_inputs[applied].pressed);
+        applied++;
+    }
+    queued_inputs.erase(queued_inputs.begin(), queued_inputs.begin() + applied);
+
+    if (!queued_inputs.empty()) {
+        scheduler.schedule(Scheduler::EVENT_JOYPAD, queued_inputs.front().cycle);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "cpu.h"
+#include "mmu.h"
+#include "ppu.h"
+#include "rom.h"
+#include "joypad.h"
+#include "scheduler.h"
+#include "interrupts.h"
+
+/**
+ * @brief Owns and wires together every emulated component of a single Game Boy.
+ * 
+ * This is the frontend-agnostic entry point to the emulator core - it has no SDL dependency, so it can be driven
+ * by the SDL frontend as well as by the headless runner used on display-less machines.
+ */
+class GameBoy {
+    public:
+        // 4194304 Hz / 70224 cycles/frame = 59.7275 Hz
+        static const int CYCLES_PER_FRAME = 70224;
+        static constexpr double FRAMES_PER_SECOND = 59.7275;
+        static constexpr double CLOCK_HZ = 4194304.0;
+
+        // How often a battery save file is written back to disk, on top of whenever the game disables its RAM
+        static const int SAVE_FLUSH_FRAMES = 60;
+
+        GameBoy();
+
+        // Components are wired together by pointer, so a GameBoy can't be copied
+        GameBoy(const GameBoy&) = delete;
+        GameBoy& operator=(const GameBoy&) = delete;
+
+        Scheduler scheduler;
+        InterruptController interrupts;
+        MMU mmu;
+        CPU cpu;
+        PPU ppu;
+        Joypad joypad;
+
+        // Load a cartridge ROM from disk and map it into the MMU
+        bool load_rom(const char* filename);
+
+        // Insert an already opened ROM - instances running the same game share it instead of mapping it again
+        bool load_rom(std::shared_ptr<const ROM> rom);
+
+        // Back the cartridge's external RAM with a battery save file, flushed to disk every SAVE_FLUSH_FRAMES
+        // Returns false if the cartridge has no RAM or the file can't be mapped
+        bool load_save(const char* filename);
+
+        // Execute one CPU instruction and advance the master clock by the same number of cycles, running any
+        // scheduler events that came due
+        // Returns the number of cycles consumed - 0 once a fault has halted the CPU (see get_fault())
+        uint8_t step();
+
+        // Like step(), but runs up to the next scheduler event (or max_cycles - use it to bound joypad latency) in
+        // one go through CPU::run() when the block cache is off, and while the CPU is halted or spinning in an idle
+        // loop, jumps straight there
+        // The result is exactly the same as stepping there one instruction at a time
+        // Returns the number of cycles consumed - 0 once a fault has halted the CPU
+        uint32_t advance(uint32_t max_cycles);
+
+        // Run until a full frame's worth of cycles has elapsed, a pausing watchpoint is hit (see CPU::watch_paused)
+        // or a fault halts the CPU (see get_fault())
+        // Returns the number of cycles consumed (may overshoot CYCLES_PER_FRAME by one instruction)
+        uint32_t run_frame();
+
+        // Last fault the program caused, FAULT_NONE if there was none - under FAULT_POLICY_HALT the machine stops
+        // running until CPU::clear_fault() is called
+        const Fault& get_fault() const { return cpu.fault; }
+        bool is_fault_halted() const { return cpu.fault_halted; }
+
+        // Update a joypad button, requesting the joypad interrupt if needed
+        void set_button(Joypad::Button button, bool pressed);
+
+        // Press or release a button once the master clock reaches a given cycle (e.g. scripted input)
+        void queue_button(Joypad::Button button, bool pressed, uint64_t cycle);
+    private:
+        struct QueuedInput {
+            uint64_t cycle;
+            Joypad::Button button;
+            bool pressed;
+        };
+
+        // Inputs waiting for EVENT_JOYPAD, in cycle order
+        std::vector<QueuedInput> queued_inputs;
+
+        // Handle every scheduler event that has come due
+        void run_events();
+
+        // Apply the queued inputs that are due and schedule the next one
+        void apply_queued_inputs();
+
+        // PCs of the last three steps - a busy-wait loop is back at the same PC three instructions later (or on
+        // every step with the block cache or CPU::run(), which stops in front of the loop's LDH), so only those PCs
+        // are checked for one
+        uint16_t recent_pcs[3] = {};
+        uint8_t recent_index = 0;
+
+        // Fast-forward through HALT/STOP or a busy-wait loop, returns 0 if the CPU has real work to do
+        uint32_t skip_idle(uint32_t max_cycles);
+};
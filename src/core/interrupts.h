@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Owns the interrupt registers - IF ($FF0F, requested) and IE ($FFFF, enabled).
+ *
+ * The CPU has to check for a serviceable interrupt before every instruction, so instead of reading both registers
+ * through the MMU each time, the controller keeps IF & IE precomputed and only recomputes it when either register
+ * changes. The MMU delegates CPU accesses to $FF0F/$FFFF here, and the components raising interrupts (PPU, timers,
+ * joypad) call request() directly.
+ */
+class InterruptController {
+    public:
+        // Interrupt sources, by IF/IE bit - also the service priority (lowest bit first)
+        enum Interrupt : uint8_t {
+            INT_VBLANK,     // Vector $0040
+            INT_STAT,       // Vector $0048
+            INT_TIMER,      // Vector $0050
+            INT_SERIAL,     // Vector $0058
+            INT_JOYPAD      // Vector $0060
+        };
+
+        uint8_t get_if() const { return if_reg; }
+        uint8_t get_ie() const { return ie_reg; }
+
+        void set_if(uint8_t value) { if_reg = value; update(); }
+        void set_ie(uint8_t value) { ie_reg = value; update(); }
+
+        // Set or clear a single IF bit
+        void request(Interrupt interrupt) { set_if(if_reg | (1 << interrupt)); }
+        void acknowledge(Interrupt interrupt) { set_if(if_reg & ~(1 << interrupt)); }
+
+        // IF & IE - non-zero wakes a halted CPU, and is serviced while IME is set
+        uint8_t get_pending() const { return pending; }
+    private:
+        uint8_t if_reg = 0;
+        uint8_t ie_reg = 0;
+        uint8_t pending = 0;
+
+        void update() { pending = if_reg & ie_reg; }
+};
@@ -0,0 +1,962 @@
+#include "jit.h"
+#include "cpu.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Base cycle counts, taken from the opcode table
+static const uint8_t OPCODE_CYCLES[256] = {
+#define CPU_OPCODE(op, name, fn, length, base_cycles) base_cycles,
+#include "cpu_opcodes.def"
+};
+
+// Same limit as CPU::execute_block, so compiled blocks stop where interpreted ones would
+static const uint32_t BLOCK_CYCLE_LIMIT = 224;
+
+// Host registers, in x86 encoding order
+enum HostRegister { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Guest register allocation - r8-r11 are caller-saved, so A, F, B and C are written back around every helper call
+static const int REG_A = R8, REG_F = R9, REG_B = R10, REG_C = R11, REG_D = R12, REG_E = R13, REG_H = R14, REG_L = R15;
+static const int REG_SP = RBP;
+static const int REG_CPU = RBX;
+
+// Host register for each SM83 register operand encoding (B, C, D, E, H, L, (HL), A)
+static const int OPERAND_REGISTERS[8] = { REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, -1, REG_A };
+
+// 16-bit pairs as encoded in bits 4-5 of the opcode (3 is SP, or AF for PUSH/POP)
+enum Pair { PAIR_BC, PAIR_DE, PAIR_HL, PAIR_SP };
+
+// Helper call arguments
+#ifdef _WIN32
+static const int ARG0 = RCX, ARG1 = RDX, ARG2 = R8;
+#else
+static const int ARG0 = RDI, ARG1 = RSI, ARG2 = RDX;
+#endif
+
+// x86 condition codes and group-1 ALU operations (the /n field of opcodes 0x81/0x83)
+enum Condition { COND_ALWAYS = -1, COND_B = 0x2, COND_AE = 0x3, COND_E = 0x4, COND_NE = 0x5 };
+enum AluOperation { ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP };
+
+// Control flow left to the interpreter handlers - calls, returns, restarts and JP HL
+static bool is_called_out_jump(uint8_t opcode) {
+    switch (opcode) {
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8: case 0xC9: case 0xD9:
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC: case 0xCD:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+        case 0xE9:
+            return true;
+        default:
+            return false;
+    }
+}
+
+JIT::JIT(CPU* c) : cpu(c) {
+#ifdef _WIN32
+    code_buffer = static_cast<uint8_t*>(VirtualAlloc(nullptr, CODE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+    void* memory = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    code_buffer = (memory == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(memory);
+#endif
+    if (!code_buffer) {
+        throw std::runtime_error("[JIT] Failed to allocate executable memory");
+    }
+
+    // LAHF puts ZF in bit 6, AF in bit 4 and CF in bit 0 - the SM83 wants them in bits 7, 5 and 4
+    for (int ah = 0; ah < 256; ah++) {
+        flag_table[ah] = ((ah & 0x40) ? 0x80 : 0) | ((ah & 0x10) ? 0x20 : 0) | ((ah & 0x01) ? 0x10 : 0);
+    }
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(cpu);
+    auto offset_of = [base](const void* member) {
+        return static_cast<int32_t>(static_cast<const uint8_t*>(member) - base);
+    };
+
+    offset_a = offset_of(&cpu->a);
+    offset_f = offset_of(&cpu->f);
+    offset_b = offset_of(&cpu->b);
+    offset_c = offset_of(&cpu->c);
+    offset_d = offset_of(&cpu->d);
+    offset_e = offset_of(&cpu->e);
+    offset_h = offset_of(&cpu->h);
+    offset_l = offset_of(&cpu->l);
+    offset_sp = offset_of(&cpu->sp);
+    offset_pc = offset_of(&cpu->pc);
+    offset_operands = offset_of(cpu->operands);
+    offset_instructions = offset_of(&cpu->total_instructions);
+    offset_aborted = offset_of(&cpu->block_aborted);
+    offset_instruction_pc = offset_of(&cpu->instruction_pc);
+}
+
+JIT::~JIT() {
+#ifdef _WIN32
+    VirtualFree(code_buffer, 0, MEM_RELEASE);
+#else
+    munmap(code_buffer, CODE_BUFFER_SIZE);
+#endif
+}
+
+uint32_t JIT::run(BlockCache::NativeCode code) {
+    cpu->block_aborted = false;
+    return code(cpu);
+}
+
+uint32_t JIT::read_helper(CPU* cpu, uint32_t address) {
+    return cpu->mmu->read_byte(static_cast<uint16_t>(address));
+}
+
+void JIT::write_helper(CPU* cpu, uint32_t address, uint32_t value) {
+    cpu->mmu->write_byte(static_cast<uint16_t>(address), static_cast<uint8_t>(value));
+}
+
+uint32_t JIT::execute_helper(CPU* cpu, uint32_t opcode) {
+    // Compiled code keeps F in a host register, so the flags have to be real again before returning
+    uint32_t cycles = cpu->execute(static_cast<uint8_t>(opcode));
+    cpu->materialize_flags();
+    return cycles;
+}
+
+BlockCache::NativeCode JIT::compile(const BlockCache::Block& block) {
+    // HALT and STOP change the run state, EI needs the interpreter's IME delay handling and illegal opcodes fault
+    for (int i = 0; i < block.count; i++) {
+        uint8_t opcode = block.instructions[i].opcode;
+        if (opcode == 0x76 || opcode == 0x10 || opcode == 0xFB || (OPCODE_CYCLES[opcode] == 0 && opcode != 0xCB)) {
+            return nullptr;
+        }
+    }
+
+    // Start again from an empty buffer once it fills up - every block has to be recompiled, including this one, which
+    // the flush has just dropped from the cache (it is interpreted this time and compiled once it's hot again)
+    if (CODE_BUFFER_SIZE - code_used < MAX_BLOCK_CODE) {
+        code_used = 0;
+        cpu->block_cache.clear();
+        return nullptr;
+    }
+
+    size_t start = code_used;
+    code_overflow = false;
+    pending_exits.clear();
+
+    // Shared epilogue, placed before the entry point so exits can jump straight back to it
+    epilogue = code_used;
+#ifdef _WIN32
+    alu_imm(ALU_ADD, RSP, 40);
+    emit8(0x5F);                                            // pop rdi
+    emit8(0x5E);                                            // pop rsi
+#else
+    alu_imm(ALU_ADD, RSP, 8);
+#endif
+    emit8(0x41); emit8(0x5F);                               // pop r15
+    emit8(0x41); emit8(0x5E);                               // pop r14
+    emit8(0x41); emit8(0x5D);                               // pop r13
+    emit8(0x41); emit8(0x5C);                               // pop r12
+    emit8(0x5D);                                            // pop rbp
+    emit8(0x5B);                                            // pop rbx
+    emit8(0xC3);                                            // ret
+
+    // Prologue - save callee-saved registers, keep the stack 16-byte aligned for helper calls and load the guest state
+    size_t entry = code_used;
+    emit8(0x53);                                            // push rbx
+    emit8(0x55);                                            // push rbp
+    emit8(0x41); emit8(0x54);                               // push r12
+    emit8(0x41); emit8(0x55);                               // push r13
+    emit8(0x41); emit8(0x56);                               // push r14
+    emit8(0x41); emit8(0x57);                               // push r15
+#ifdef _WIN32
+    emit8(0x56);                                            // push rsi
+    emit8(0x57);                                            // push rdi
+    alu_imm(ALU_SUB, RSP, 40);                              // shadow space + alignment
+#else
+    alu_imm(ALU_SUB, RSP, 8);
+#endif
+    op_reg(0x89, ARG0, REG_CPU, true);                      // mov rbx, cpu
+    load_registers(false);
+
+    uint16_t address = block.key & 0xFFFF;
+    uint32_t cycles = 0;
+    bool exited = false;
+
+    for (int i = 0; i < block.count && !exited; i++) {
+        const BlockCache::DecodedInstruction& instruction = block.instructions[i];
+        uint8_t opcode = instruction.opcode;
+        uint16_t next = address + instruction.length;
+        uint32_t executed = i + 1;
+        uint32_t cycles_before = cycles;
+        may_abort = false;
+        instruction_address = address;
+
+        switch (opcode) {
+            // JR e8 / JP a16
+            case 0x18:
+                emit_exit(next + static_cast<int8_t>(instruction.operands[0]), false, cycles + 12, executed);
+                exited = true;
+                break;
+            case 0xC3:
+                emit_exit(instruction.operands[0] | (instruction.operands[1] << 8), false, cycles + 16, executed);
+                exited = true;
+                break;
+
+            // JR cc, e8 / JP cc, a16
+            case 0x20: case 0x28: case 0x30: case 0x38:
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA: {
+                int condition = (opcode >> 3) & 0x03;               // NZ, Z, NC, C
+                bool relative = opcode < 0x40;
+                uint16_t target = relative ? static_cast<uint16_t>(next + static_cast<int8_t>(instruction.operands[0]))
+                                           : static_cast<uint16_t>(instruction.operands[0] | (instruction.operands[1] << 8));
+
+                op_reg(0xF6, 0, REG_F, false, true);                // test F, flag
+                emit8((condition < 2) ? 0x80 : 0x10);
+                size_t patch = jump_forward((condition & 1) ? COND_NE : COND_E);
+                pending_exits.push_back({ patch, target, cycles + (relative ? 12u : 16u), executed });
+
+                emit_exit(next, false, cycles + OPCODE_CYCLES[opcode], executed);
+                exited = true;
+                break;
+            }
+
+            default:
+                if (!emit_native(instruction)) {
+                    emit_callout(instruction, address);
+
+                    // Calls, returns, restarts and JP HL set PC themselves and return their own cycle count (in eax)
+                    if (is_called_out_jump(opcode)) {
+                        emit_exit(0, true, cycles, executed);
+                        exited = true;
+                        break;
+                    }
+                }
+
+                // CB-prefixed instructions take 8 cycles, or 16 with an (HL) operand
+                if (opcode == 0xCB) {
+                    cycles += ((instruction.operands[0] & 0x07) == 6) ? 16 : 8;
+                } else {
+                    cycles += OPCODE_CYCLES[opcode];
+                }
+                break;
+        }
+
+        if (exited) break;
+
+        bool last = (cycles >= BLOCK_CYCLE_LIMIT || i + 1 == block.count);
+
+        // Move the master clock past this instruction and stop once an event has come due, like the interpreter - the
+        // last instruction's cycles are added by CPU::execute_block()
+        if (cpu->scheduler && !last) {
+            Scheduler* scheduler = cpu->scheduler;
+            int32_t offset_deadline = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&scheduler->next_deadline) -
+                                                           reinterpret_cast<const uint8_t*>(&scheduler->cycle));
+
+            mov_imm64(RSI, reinterpret_cast<uint64_t>(&scheduler->cycle));
+            op_mem(0x81, ALU_ADD, RSI, 0, true);                     // add qword [cycle], n
+            emit32(cycles - cycles_before);
+            op_mem(0x8B, RAX, RSI, 0, true);                         // mov rax, [cycle]
+            op_mem(0x3B, RAX, RSI, offset_deadline, true);           // cmp rax, [next_deadline]
+            size_t patch = jump_forward(COND_AE);
+            pending_exits.push_back({ patch, next, cycles, executed });
+        }
+
+        // A write may have switched banks or modified cached code, and a fault may have halted the CPU - stop after
+        // this instruction like the interpreter
+        if (may_abort) {
+            op_mem(0x80, 7, REG_CPU, offset_aborted);              // cmp byte [aborted], 0
+            emit8(0);
+            size_t patch = jump_forward(COND_NE);
+            pending_exits.push_back({ patch, next, cycles, executed });
+        }
+
+        address = next;
+
+        if (last) {
+            emit_exit(address, false, cycles, executed);
+            exited = true;
+        }
+    }
+
+    // Branch and abort exits
+    for (size_t i = 0; i < pending_exits.size(); i++) {
+        bind(pending_exits[i].patch);
+        emit_exit(pending_exits[i].pc, false, pending_exits[i].cycles, pending_exits[i].instructions);
+    }
+
+    if (code_overflow) {
+        code_used = start;
+        return nullptr;
+    }
+
+    return reinterpret_cast<BlockCache::NativeCode>(code_buffer + entry);
+}
+
+bool JIT::emit_native(const BlockCache::DecodedInstruction& instruction) {
+    uint8_t opcode = instruction.opcode;
+    uint8_t n8 = instruction.operands[0];
+    uint16_t n16 = instruction.operands[0] | (instruction.operands[1] << 8);
+    int pair = (opcode >> 4) & 0x03;
+
+    // LD r, r' / LD r, (HL) / LD (HL), r
+    if (opcode >= 0x40 && opcode <= 0x7F) {
+        int destination = OPERAND_REGISTERS[(opcode >> 3) & 0x07];
+        int source = OPERAND_REGISTERS[opcode & 0x07];
+
+        if (source < 0) {
+            load_pair(PAIR_HL, RCX);
+            emit_read();
+            mov_reg(destination, RAX);
+        } else if (destination < 0) {
+            load_pair(PAIR_HL, RCX);
+            mov_reg(RDX, source);
+            emit_write();
+        } else if (destination != source) {
+            mov_reg(destination, source);
+        }
+        return true;
+    }
+
+    // ADD/ADC/SUB/SBC/AND/XOR/OR/CP A, r / A, (HL)
+    if (opcode >= 0x80 && opcode <= 0xBF) {
+        int source = OPERAND_REGISTERS[opcode & 0x07];
+        if (source < 0) {
+            load_pair(PAIR_HL, RCX);
+            emit_read();
+            source = RAX;
+        }
+        emit_alu((opcode >> 3) & 0x07, source);
+        return true;
+    }
+
+    switch (opcode) {
+        case 0x00: // NOP
+            return true;
+
+        // LD r, n8
+        case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+            mov_imm(OPERAND_REGISTERS[(opcode >> 3) & 0x07], n8);
+            return true;
+
+        // LD (HL), n8
+        case 0x36:
+            load_pair(PAIR_HL, RCX);
+            mov_imm(RDX, n8);
+            emit_write();
+            return true;
+
+        // ADD/ADC/SUB/SBC/AND/XOR/OR/CP A, n8
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+            mov_imm(RSI, n8);
+            emit_alu((opcode >> 3) & 0x07, RSI);
+            return true;
+
+        // INC r / DEC r - C is left alone
+        case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C:
+        case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D: {
+            bool decrement = opcode & 0x01;
+            op_reg(0xFE, decrement ? 1 : 0, OPERAND_REGISTERS[(opcode >> 3) & 0x07], false, true);
+            emit_flags(0xA0, decrement ? 0x40 : 0x00, 0x10);
+            return true;
+        }
+
+        // INC (HL) / DEC (HL)
+        case 0x34: case 0x35: {
+            bool decrement = opcode & 0x01;
+            load_pair(PAIR_HL, RCX);
+            emit_read();
+            op_reg(0xFE, decrement ? 1 : 0, RAX, false, true);
+            mov_reg(RSI, RAX);
+            emit_flags(0xA0, decrement ? 0x40 : 0x00, 0x10);
+            load_pair(PAIR_HL, RCX);
+            mov_reg(RDX, RSI);
+            emit_write();
+            return true;
+        }
+
+        // INC rr / DEC rr
+        case 0x03: case 0x13: case 0x23: case 0x33:
+        case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+            load_pair(pair, RCX);
+            op_reg(0xFF, (opcode & 0x08) ? 1 : 0, RCX);     // inc/dec ecx
+            store_pair(pair, RCX);
+            return true;
+
+        // LD rr, n16
+        case 0x01: case 0x11: case 0x21: case 0x31:
+            mov_imm(RCX, n16);
+            store_pair(pair, RCX);
+            return true;
+
+        // LD (BC), A / LD (DE), A / LD A, (BC) / LD A, (DE)
+        case 0x02: case 0x12:
+            load_pair(pair, RCX);
+            mov_reg(RDX, REG_A);
+            emit_write();
+            return true;
+        case 0x0A: case 0x1A:
+            load_pair(pair, RCX);
+            emit_read();
+            mov_reg(REG_A, RAX);
+            return true;
+
+        // LD (HL+), A / LD (HL-), A / LD A, (HL+) / LD A, (HL-)
+        case 0x22: case 0x32: case 0x2A: case 0x3A:
+            load_pair(PAIR_HL, RCX);
+            if (opcode & 0x08) {
+                emit_read();
+                mov_reg(REG_A, RAX);
+            } else {
+                mov_reg(RDX, REG_A);
+                emit_write();
+            }
+            load_pair(PAIR_HL, RCX);
+            op_reg(0xFF, (opcode & 0x10) ? 1 : 0, RCX);
+            store_pair(PAIR_HL, RCX);
+            return true;
+
+        // LDH (a8), A / LDH A, (a8) / LD (a16), A / LD A, (a16)
+        case 0xE0:
+            mov_reg(RDX, REG_A);
+            emit_write(0xFF00 + n8);
+            return true;
+        case 0xF0:
+            emit_read(0xFF00 + n8);
+            mov_reg(REG_A, RAX);
+            return true;
+        case 0xEA:
+            mov_reg(RDX, REG_A);
+            emit_write(n16);
+            return true;
+        case 0xFA:
+            emit_read(n16);
+            mov_reg(REG_A, RAX);
+            return true;
+
+        // LDH (C), A / LDH A, (C)
+        case 0xE2:
+            mov_reg(RCX, REG_C);
+            alu_imm(ALU_OR, RCX, 0xFF00);
+            mov_reg(RDX, REG_A);
+            emit_write();
+            return true;
+        case 0xF2:
+            mov_reg(RCX, REG_C);
+            alu_imm(ALU_OR, RCX, 0xFF00);
+            emit_read();
+            mov_reg(REG_A, RAX);
+            return true;
+
+        // PUSH rr - SP drops by two, then the low byte is written first (as MMU::write_word does)
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5: {
+            static const int HIGH[4] = { REG_B, REG_D, REG_H, REG_A };
+            static const int LOW[4] = { REG_C, REG_E, REG_L, REG_F };
+
+            alu_imm(ALU_SUB, REG_SP, 2);
+            op_reg(0x0FB7, REG_SP, REG_SP);                 // movzx ebp, bp
+            mov_reg(RCX, REG_SP);
+            mov_reg(RDX, LOW[pair]);
+            emit_write();
+            mov_reg(RCX, REG_SP);
+            op_reg(0xFF, 0, RCX);                           // inc ecx
+            op_reg(0x0FB7, RCX, RCX);                       // movzx ecx, cx
+            mov_reg(RDX, HIGH[pair]);
+            emit_write();
+            return true;
+        }
+
+        // POP rr - the low byte of AF only keeps the flag bits
+        case 0xC1: case 0xD1: case 0xE1: case 0xF1: {
+            static const int HIGH[4] = { REG_B, REG_D, REG_H, REG_A };
+            static const int LOW[4] = { REG_C, REG_E, REG_L, REG_F };
+
+            mov_reg(RCX, REG_SP);
+            emit_read();
+            if (pair == PAIR_SP) {
+                alu_imm(ALU_AND, RAX, 0xF0);
+            }
+            mov_reg(LOW[pair], RAX);
+            mov_reg(RCX, REG_SP);
+            op_reg(0xFF, 0, RCX);
+            op_reg(0x0FB7, RCX, RCX);
+            emit_read();
+            mov_reg(HIGH[pair], RAX);
+            alu_imm(ALU_ADD, REG_SP, 2);
+            op_reg(0x0FB7, REG_SP, REG_SP);
+            return true;
+        }
+
+        // CPL / SCF / CCF
+        case 0x2F:
+            alu_imm(ALU_XOR, REG_A, 0xFF);
+            alu_imm(ALU_OR, REG_F, 0x60);
+            return true;
+        case 0x37:
+            alu_imm(ALU_AND, REG_F, 0x80);
+            alu_imm(ALU_OR, REG_F, 0x10);
+            return true;
+        case 0x3F:
+            alu_imm(ALU_AND, REG_F, 0x90);
+            alu_imm(ALU_XOR, REG_F, 0x10);
+            return true;
+
+        // BIT/RES/SET on a register - shifts, rotates and (HL) operands go through the interpreter
+        case 0xCB: {
+            int reg = OPERAND_REGISTERS[n8 & 0x07];
+            uint8_t mask = 1 << ((n8 >> 3) & 0x07);
+            if (n8 < 0x40 || reg < 0) return false;
+
+            switch (n8 >> 6) {
+                case 0x01:
+                    alu_imm(ALU_AND, REG_F, 0x10);
+                    alu_imm(ALU_OR, REG_F, 0x20);
+                    op_reg(0xF6, 0, reg, false, true);      // test r, mask
+                    emit8(mask);
+                    op_reg(0x0F94, 0, RAX, false, true);    // setz al
+                    op_reg(0x0FB6, RAX, RAX, false, true);  // movzx eax, al
+                    op_reg(0xC1, 4, RAX);                   // shl eax, 7
+                    emit8(7);
+                    op_reg(0x09, RAX, REG_F);               // or F, eax
+                    return true;
+                case 0x02:
+                    alu_imm(ALU_AND, reg, static_cast<uint8_t>(~mask));
+                    return true;
+                default:
+                    alu_imm(ALU_OR, reg, mask);
+                    return true;
+            }
+        }
+
+        default:
+            return false;
+    }
+}
+
+void JIT::emit_callout(const BlockCache::DecodedInstruction& instruction, uint16_t address) {
+    // The handler sees exactly the state the interpreter would give it - PC past the opcode, operands prefetched
+    store_registers(false);
+    emit_instruction_pc();
+    emit8(0x66);
+    op_mem(0xC7, 0, REG_CPU, offset_pc);                    // mov word [pc], address + 1
+    emit16(address + 1);
+    op_mem(0xC6, 0, REG_CPU, offset_operands);              // mov byte [operands], imm8
+    emit8(instruction.operands[0]);
+    op_mem(0xC6, 0, REG_CPU, offset_operands + 1);
+    emit8(instruction.operands[1]);
+
+    mov_imm(ARG1, instruction.opcode);
+    op_reg(0x89, REG_CPU, ARG0, true);
+    emit_call(reinterpret_cast<const void*>(&JIT::execute_helper));
+    load_registers(false);
+    may_abort = true;
+}
+
+void JIT::emit_alu(int operation, int source) {
+    // SM83 operation order (ADD, ADC, SUB, SBC, AND, XOR, OR, CP) to the x86 "op r/m8, r8" opcode
+    static const uint8_t OPCODES[8] = { 0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38 };
+
+    // ADC/SBC - load the guest carry into CF first
+    if (operation == 1 || operation == 3) {
+        op_reg(0x0FBA, 4, REG_F);                           // bt F, 4
+        emit8(4);
+    }
+
+    op_reg(OPCODES[operation], source, REG_A, false, true);
+
+    switch (operation) {
+        case 4:  emit_flags(0x80, 0x20, 0x00); break;       // AND - Z, H set
+        case 5:
+        case 6:  emit_flags(0x80, 0x00, 0x00); break;       // XOR/OR - Z only
+        case 0:
+        case 1:  emit_flags(0xB0, 0x00, 0x00); break;       // ADD/ADC
+        default: emit_flags(0xB0, 0x40, 0x00); break;       // SUB/SBC/CP
+    }
+}
+
+void JIT::emit_flags(uint8_t take, uint8_t set, uint8_t keep) {
+    // x86 ZF/AF/CF match SM83 Z/H/C for 8-bit add, subtract, increment and decrement - F = (F & keep) | (host & take) | set
+    emit8(0x9F);                                            // lahf
+    emit8(0x0F); emit8(0xB6); emit8(0xC4);                  // movzx eax, ah
+    mov_imm64(RDX, reinterpret_cast<uint64_t>(flag_table));
+    op_index(0x0FB6, RAX, RDX, RAX);                        // movzx eax, byte [rdx + rax]
+
+    if (take != 0xB0) {
+        alu_imm(ALU_AND, RAX, take);
+    }
+
+    if (keep) {
+        alu_imm(ALU_AND, REG_F, keep);
+        op_reg(0x09, RAX, REG_F);                           // or F, eax
+    } else {
+        mov_reg(REG_F, RAX);
+    }
+
+    if (set) {
+        alu_imm(ALU_OR, REG_F, set);
+    }
+}
+
+void JIT::emit_read(int32_t constant_address) {
+    // Address in ecx (or known at compile time), value returned zero-extended in eax
+    uint8_t* wram = cpu->mmu->wram;
+    uint8_t* hram = cpu->mmu->hram;
+
+    if (constant_address >= 0) {
+        if (constant_address >= 0xC000 && constant_address <= 0xDFFF) {
+            mov_imm64(RDX, reinterpret_cast<uint64_t>(wram + (constant_address - 0xC000)));
+            op_mem(0x0FB6, RAX, RDX, 0);
+            return;
+        }
+        if (constant_address >= 0xFF80 && constant_address <= 0xFFFE) {
+            mov_imm64(RDX, reinterpret_cast<uint64_t>(hram + (constant_address - 0xFF80)));
+            op_mem(0x0FB6, RAX, RDX, 0);
+            return;
+        }
+
+        mov_imm(RCX, constant_address);
+        store_registers(true);
+        emit_instruction_pc();
+        op_reg(0x89, RCX, ARG1);
+        op_reg(0x89, REG_CPU, ARG0, true);
+        emit_call(reinterpret_cast<const void*>(&JIT::read_helper));
+        load_registers(true);
+        may_abort = true;
+        return;
+    }
+
+    // Page table - ROM banks, VRAM, external RAM, WRAM and echo RAM
+    emit_page_lookup(cpu->mmu->read_pages, RDX);
+    size_t not_mapped = jump_forward(COND_E);
+    op_reg(0x0FB6, RAX, RCX, false, true);                  // movzx eax, cl
+    op_index(0x0FB6, RAX, RDX, RAX);                        // movzx eax, byte [rdx + rax]
+    size_t done_mapped = jump_forward(COND_ALWAYS);
+
+    // HRAM
+    bind(not_mapped);
+    mov_reg(RAX, RCX);
+    alu_imm(ALU_SUB, RAX, 0xFF80);
+    alu_imm(ALU_CMP, RAX, 0x7F);
+    size_t not_hram = jump_forward(COND_AE);
+    mov_imm64(RDX, reinterpret_cast<uint64_t>(hram));
+    op_index(0x0FB6, RAX, RDX, RAX);
+    size_t done_hram = jump_forward(COND_ALWAYS);
+
+    // Everything else goes through the MMU
+    bind(not_hram);
+    store_registers(true);
+    emit_instruction_pc();
+    op_reg(0x89, RCX, ARG1);
+    op_reg(0x89, REG_CPU, ARG0, true);
+    emit_call(reinterpret_cast<const void*>(&JIT::read_helper));
+    load_registers(true);
+    may_abort = true;
+
+    bind(done_mapped);
+    bind(done_hram);
+}
+
+void JIT::emit_write(int32_t constant_address) {
+    // Address in ecx (or known at compile time), value in edx
+    // RAM bytes belonging to cached code take the MMU path so the block cache hears about the write
+    uint8_t* wram = cpu->mmu->wram;
+    uint8_t* hram = cpu->mmu->hram;
+    uint8_t* code_bitmap = cpu->block_cache.code_bitmap;
+    may_abort = true;
+
+    if (constant_address >= 0) {
+        bool in_wram = constant_address >= 0xC000 && constant_address <= 0xDFFF;
+        bool in_hram = constant_address >= 0xFF80 && constant_address <= 0xFFFE;
+        size_t is_code = 0;
+
+        if (in_wram || in_hram) {
+            mov_imm64(RSI, reinterpret_cast<uint64_t>(code_bitmap + (constant_address >> 3)));
+            op_mem(0xF6, 0, RSI, 0);                        // test byte [bitmap], bit
+            emit8(1 << (constant_address & 0x07));
+            is_code = jump_forward(COND_NE);
+
+            uint8_t* target = in_wram ? wram + (constant_address - 0xC000) : hram + (constant_address - 0xFF80);
+            mov_imm64(RSI, reinterpret_cast<uint64_t>(target));
+            op_mem(0x88, RDX, RSI, 0, false, true);         // mov byte [rsi], dl
+            size_t done = jump_forward(COND_ALWAYS);
+
+            bind(is_code);
+            mov_imm(RCX, constant_address);
+            store_registers(true);
+            emit_instruction_pc();
+            if (ARG2 != RDX) op_reg(0x89, RDX, ARG2);
+            op_reg(0x89, RCX, ARG1);
+            op_reg(0x89, REG_CPU, ARG0, true);
+            emit_call(reinterpret_cast<const void*>(&JIT::write_helper));
+            load_registers(true);
+            bind(done);
+            return;
+        }
+
+        mov_imm(RCX, constant_address);
+        store_registers(true);
+        emit_instruction_pc();
+        if (ARG2 != RDX) op_reg(0x89, RDX, ARG2);
+        op_reg(0x89, RCX, ARG1);
+        op_reg(0x89, REG_CPU, ARG0, true);
+        emit_call(reinterpret_cast<const void*>(&JIT::write_helper));
+        load_registers(true);
+        return;
+    }
+
+    // Code bitmap bit for ecx - set means the MMU has to invalidate blocks
+    mov_reg(RSI, RCX);
+    op_reg(0xC1, 5, RSI);                                   // shr esi, 3
+    emit8(3);
+    mov_imm64(RDI, reinterpret_cast<uint64_t>(code_bitmap));
+    op_index(0x0FB6, RSI, RDI, RSI);                        // movzx esi, byte [rdi + rsi]
+    mov_reg(RDI, RCX);
+    alu_imm(ALU_AND, RDI, 0x07);
+    op_reg(0x0FA3, RDI, RSI);                               // bt esi, edi
+    size_t is_code = jump_forward(COND_B);
+
+    // Page table - enabled external RAM and WRAM
+    emit_page_lookup(cpu->mmu->write_pages, RSI);
+    size_t not_mapped = jump_forward(COND_E);
+    op_reg(0x0FB6, RAX, RCX, false, true);                  // movzx eax, cl
+    op_index(0x88, RDX, RSI, RAX, true);                    // mov byte [rsi + rax], dl
+    size_t done_mapped = jump_forward(COND_ALWAYS);
+
+    // HRAM
+    bind(not_mapped);
+    mov_reg(RAX, RCX);
+    alu_imm(ALU_SUB, RAX, 0xFF80);
+    alu_imm(ALU_CMP, RAX, 0x7F);
+    size_t not_hram = jump_forward(COND_AE);
+    mov_imm64(RSI, reinterpret_cast<uint64_t>(hram));
+    op_index(0x88, RDX, RSI, RAX, true);
+    size_t done_hram = jump_forward(COND_ALWAYS);
+
+    // Everything else goes through the MMU
+    bind(is_code);
+    bind(not_hram);
+    store_registers(true);
+    emit_instruction_pc();
+    if (ARG2 != RDX) op_reg(0x89, RDX, ARG2);
+    op_reg(0x89, RCX, ARG1);
+    op_reg(0x89, REG_CPU, ARG0, true);
+    emit_call(reinterpret_cast<const void*>(&JIT::write_helper));
+    load_registers(true);
+
+    bind(done_mapped);
+    bind(done_hram);
+}
+
+void JIT::emit_page_lookup(const void* table, int reg) {
+    // Host pointer of the page holding ecx into reg (flags set for a null test), clobbers eax
+    mov_reg(RAX, RCX);
+    alu_imm(ALU_AND, RAX, 0x10000 - MMU::PAGE_SIZE);
+    op_reg(0xC1, 5, RAX);                                   // shr eax, PAGE_SHIFT - 3 (page number * 8)
+    emit8(MMU::PAGE_SHIFT - 3);
+    mov_imm64(reg, reinterpret_cast<uint64_t>(table));
+    op_index(0x8B, reg, reg, RAX, false, true);             // mov reg, qword [reg + rax]
+    op_reg(0x85, reg, reg, true);                           // test reg, reg
+}
+
+void JIT::emit_instruction_pc() {
+    // Faults and watchpoint hits raised by a helper are reported at this instruction
+    emit8(0x66);
+    op_mem(0xC7, 0, REG_CPU, offset_instruction_pc);        // mov word [instruction_pc], address
+    emit16(instruction_address);
+}
+
+void JIT::emit_call(const void* function) {
+    mov_imm64(RAX, reinterpret_cast<uint64_t>(function));
+    emit8(0xFF); emit8(0xD0);                               // call rax
+}
+
+void JIT::emit_exit(uint16_t pc, bool dynamic_pc, uint32_t cycles, uint32_t instructions) {
+    store_registers(false);
+
+    if (!dynamic_pc) {
+        emit8(0x66);
+        op_mem(0xC7, 0, REG_CPU, offset_pc);
+        emit16(pc);
+    }
+
+    op_mem(0x81, ALU_ADD, REG_CPU, offset_instructions, true);  // add qword [total_instructions], n
+    emit32(instructions);
+
+    // After a control flow call-out, eax already holds the handler's cycles
+    if (dynamic_pc) {
+        alu_imm(ALU_ADD, RAX, cycles);
+    } else {
+        mov_imm(RAX, cycles);
+    }
+    jump_to(epilogue);
+}
+
+void JIT::load_pair(int pair, int destination) {
+    static const int HIGH[3] = { REG_B, REG_D, REG_H };
+    static const int LOW[3] = { REG_C, REG_E, REG_L };
+
+    if (pair == PAIR_SP) {
+        mov_reg(destination, REG_SP);
+        return;
+    }
+
+    mov_reg(destination, HIGH[pair]);
+    op_reg(0xC1, 4, destination);                           // shl destination, 8
+    emit8(8);
+    op_reg(0x09, LOW[pair], destination);                   // or destination, low
+}
+
+void JIT::store_pair(int pair, int source) {
+    static const int HIGH[3] = { REG_B, REG_D, REG_H };
+    static const int LOW[3] = { REG_C, REG_E, REG_L };
+
+    if (pair == PAIR_SP) {
+        op_reg(0x0FB7, REG_SP, source);                     // movzx ebp, source16
+        return;
+    }
+
+    op_reg(0x0FB6, LOW[pair], source, false, true);         // movzx low, source8
+    op_reg(0xC1, 5, source);                                // shr source, 8
+    emit8(8);
+    op_reg(0x0FB6, HIGH[pair], source, false, true);        // movzx high, source8
+}
+
+void JIT::load_registers(bool volatile_only) {
+    op_mem(0x0FB6, REG_A, REG_CPU, offset_a);
+    op_mem(0x0FB6, REG_F, REG_CPU, offset_f);
+    op_mem(0x0FB6, REG_B, REG_CPU, offset_b);
+    op_mem(0x0FB6, REG_C, REG_CPU, offset_c);
+    if (volatile_only) return;
+
+    op_mem(0x0FB6, REG_D, REG_CPU, offset_d);
+    op_mem(0x0FB6, REG_E, REG_CPU, offset_e);
+    op_mem(0x0FB6, REG_H, REG_CPU, offset_h);
+    op_mem(0x0FB6, REG_L, REG_CPU, offset_l);
+    op_mem(0x0FB7, REG_SP, REG_CPU, offset_sp);
+}
+
+void JIT::store_registers(bool volatile_only) {
+    op_mem(0x88, REG_A, REG_CPU, offset_a, false, true);
+    op_mem(0x88, REG_F, REG_CPU, offset_f, false, true);
+    op_mem(0x88, REG_B, REG_CPU, offset_b, false, true);
+    op_mem(0x88, REG_C, REG_CPU, offset_c, false, true);
+    if (volatile_only) return;
+
+    op_mem(0x88, REG_D, REG_CPU, offset_d, false, true);
+    op_mem(0x88, REG_E, REG_CPU, offset_e, false, true);
+    op_mem(0x88, REG_H, REG_CPU, offset_h, false, true);
+    op_mem(0x88, REG_L, REG_CPU, offset_l, false, true);
+    emit8(0x66);
+    op_mem(0x89, REG_SP, REG_CPU, offset_sp);
+}
+
+void JIT::emit8(uint8_t value) {
+    if (code_used >= CODE_BUFFER_SIZE) {
+        code_overflow = true;
+        return;
+    }
+    code_buffer[code_used++] = value;
+}
+
+void JIT::emit16(uint16_t value) {
+    emit8(value & 0xFF);
+    emit8(value >> 8);
+}
+
+void JIT::emit32(uint32_t value) {
+    emit16(value & 0xFFFF);
+    emit16(value >> 16);
+}
+
+void JIT::emit64(uint64_t value) {
+    emit32(static_cast<uint32_t>(value));
+    emit32(static_cast<uint32_t>(value >> 32));
+}
+
+void JIT::emit_rex(bool wide, int reg, int index, int base, bool byte_registers) {
+    // A plain 0x40 prefix is needed for byte access to spl/bpl/sil/dil - harmless for the other byte registers
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg & 0x08) ? 0x04 : 0) | ((index & 0x08) ? 0x02 : 0) | ((base & 0x08) ? 0x01 : 0);
+    if (rex != 0x40 || byte_registers) {
+        emit8(rex);
+    }
+}
+
+void JIT::emit_opcode(uint32_t opcode) {
+    if (opcode > 0xFF) {
+        emit8(opcode >> 8);
+    }
+    emit8(opcode & 0xFF);
+}
+
+void JIT::op_reg(uint32_t opcode, int reg, int rm, bool wide, bool byte_registers) {
+    emit_rex(wide, reg, 0, rm, byte_registers);
+    emit_opcode(opcode);
+    emit8(0xC0 | ((reg & 0x07) << 3) | (rm & 0x07));
+}
+
+void JIT::op_mem(uint32_t opcode, int reg, int base, int32_t displacement, bool wide, bool byte_registers) {
+    // [base + disp32]
+    emit_rex(wide, reg, 0, base, byte_registers);
+    emit_opcode(opcode);
+    emit8(0x80 | ((reg & 0x07) << 3) | (base & 0x07));
+    if ((base & 0x07) == RSP) {
+        emit8(0x24);
+    }
+    emit32(displacement);
+}
+
+void JIT::op_index(uint32_t opcode, int reg, int base, int index, bool byte_registers, bool wide) {
+    // [base + index] - base must not be rbp/r13, which need a displacement in this form
+    emit_rex(wide, reg, index, base, byte_registers);
+    emit_opcode(opcode);
+    emit8(0x04 | ((reg & 0x07) << 3));
+    emit8(((index & 0x07) << 3) | (base & 0x07));
+}
+
+void JIT::alu_imm(int operation, int reg, int32_t value) {
+    bool wide = (reg == RSP);
+    if (value >= -128 && value <= 127) {
+        op_reg(0x83, operation, reg, wide);
+        emit8(static_cast<uint8_t>(value));
+    } else {
+        op_reg(0x81, operation, reg, wide);
+        emit32(static_cast<uint32_t>(value));
+    }
+}
+
+void JIT::mov_reg(int destination, int source) {
+    op_reg(0x89, source, destination);
+}
+
+void JIT::mov_imm(int reg, uint32_t value) {
+    emit_rex(false, 0, 0, reg, false);
+    emit8(0xB8 | (reg & 0x07));
+    emit32(value);
+}
+
+void JIT::mov_imm64(int reg, uint64_t value) {
+    emit_rex(true, 0, 0, reg, false);
+    emit8(0xB8 | (reg & 0x07));
+    emit64(value);
+}
+
+size_t JIT::jump_forward(int condition) {
+    if (condition == COND_ALWAYS) {
+        emit8(0xE9);
+    } else {
+        emit8(0x0F);
+        emit8(0x80 | condition);
+    }
+    emit32(0);
+    return code_used - 4;
+}
+
+void JIT::jump_to(size_t target) {
+    emit8(0xE9);
+    emit32(static_cast<uint32_t>(static_cast<int32_t>(target - (code_used + 4))));
+}
+
+void JIT::bind(size_t patch) {
+    if (code_overflow) return;
+
+    uint32_t relative = static_cast<uint32_t>(code_used - (patch + 4));
+    memcpy(code_buffer + patch, &relative, sizeof(relative));
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "block_cache.h"
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "The JIT backend only targets x86-64 - configure with -DGAMEBYTE_JIT=OFF on other hosts"
+#endif
+
+class CPU;
+
+/**
+ * @brief Optional x86-64 backend that compiles hot blocks from the block cache into host code.
+ *
+ * Once a decoded block has run HOT_THRESHOLD times it is translated into a single host function. Inside that function
+ * the guest registers live in host registers (A, F, B, C, D, E, H, L in r8-r15 and SP in ebp, each zero-extended)
+ * and are only written back to the CPU when the block exits or calls out. PC is a constant at every point of a
+ * block, so it is only stored on exit and before call-outs.
+ *
+ * The common instructions (8-bit loads, ALU, INC/DEC, 16-bit loads and increments, PUSH/POP, JR/JP and BIT/RES/SET
+ * on registers) are emitted directly, with flags computed the same way the interpreter does. Memory accesses go
+ * straight to the MMU's WRAM and HRAM arrays and fall back to MMU::read_byte/write_byte for everything else, so
+ * I/O registers, MBC writes and code invalidation behave exactly as they do when interpreting. Any other
+ * instruction is "called out" - the registers are written back and its interpreter handler is run.
+ *
+ * Every exit of a block returns the exact number of cycles the interpreter would have counted up to that point, and
+ * blocks stop at the same places (cycle limit, code writes, bank switches, a scheduler event coming due). The master
+ * clock is moved after every instruction as well, so timers and the PPU see no difference.
+ */
+class JIT {
+    public:
+        // Number of runs before a block is compiled
+        static const uint32_t HOT_THRESHOLD = 16;
+
+        // Executable memory reserved for compiled blocks - it is flushed (along with the block cache) once full
+        static const size_t CODE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+        explicit JIT(CPU* cpu);
+        ~JIT();
+
+        JIT(const JIT&) = delete;
+        JIT& operator=(const JIT&) = delete;
+
+        // Translate a decoded block into host code
+        // Returns nullptr if the block has to stay interpreted
+        BlockCache::NativeCode compile(const BlockCache::Block& block);
+
+        // Run a compiled block and return the cycles it took
+        uint32_t run(BlockCache::NativeCode code);
+    private:
+        // Most host code one block can need - compile() flushes the buffer if less than this is left
+        static const size_t MAX_BLOCK_CODE = 64 * 1024;
+
+        CPU* cpu;
+
+        uint8_t* code_buffer = nullptr;
+        size_t code_used = 0;
+        bool code_overflow = false;
+
+        // Maps the host AH register (after LAHF) to SM83 Z, H and C flag bits
+        uint8_t flag_table[256];
+
+        // Offsets of CPU members, relative to the CPU pointer kept in rbx
+        int32_t offset_a, offset_f, offset_b, offset_c, offset_d, offset_e, offset_h, offset_l;
+        int32_t offset_sp, offset_pc, offset_operands, offset_instructions, offset_aborted, offset_instruction_pc;
+
+        // Exits that are jumped to from inside the block, emitted after its body
+        struct PendingExit {
+            size_t patch;
+            uint16_t pc;
+            uint32_t cycles;
+            uint32_t instructions;
+        };
+
+        std::vector<PendingExit> pending_exits;
+        size_t epilogue = 0;
+        bool may_abort = false;
+
+        // Guest address of the instruction being translated
+        uint16_t instruction_address = 0;
+
+        // Called from compiled code
+        static uint32_t read_helper(CPU* cpu, uint32_t address);
+        static void write_helper(CPU* cpu, uint32_t address, uint32_t value);
+        static uint32_t execute_helper(CPU* cpu, uint32_t opcode);
+
+        // Instruction translation
+        bool emit_native(const BlockCache::DecodedInstruction& instruction);
+        void emit_callout(const BlockCache::DecodedInstruction& instruction, uint16_t address);
+        void emit_alu(int operation, int source);
+        void emit_flags(uint8_t take, uint8_t set, uint8_t keep);
+        void emit_read(int32_t constant_address = -1);
+        void emit_write(int32_t constant_address = -1);
+        void emit_page_lookup(const void* table, int reg);
+        void emit_call(const void* function);
+        void emit_instruction_pc();
+        void emit_exit(uint16_t pc, bool dynamic_pc, uint32_t cycles, uint32_t instructions);
+        void load_pair(int pair, int destination);
+        void store_pair(int pair, int source);
+        void load_registers(bool volatile_only);
+        void store_registers(bool volatile_only);
+
+        // x86-64 encoding
+        void emit8(uint8_t value);
+        void emit16(uint16_t value);
+        void emit32(uint32_t value);
+        void emit64(uint64_t value);
+        void emit_rex(bool wide, int reg, int index, int base, bool byte_registers);
+        void emit_opcode(uint32_t opcode);
+        void op_reg(uint32_t opcode, int reg, int rm, bool wide = false, bool byte_registers = false);
+        void op_mem(uint32_t opcode, int reg, int base, int32_t displacement, bool wide = false, bool byte_registers = false);
+        void op_index(uint32_t opcode, int reg, int base, int index, bool byte_registers = false, bool wide = false);
+        void alu_imm(int operation, int reg, int32_t value);
+        void mov_reg(int destination, int source);
+        void mov_imm(int reg, uint32_t value);
+        void mov_imm64(int reg, uint64_t value);
+        size_t jump_forward(int condition);
+        void jump_to(size_t target);
+        void bind(size_t patch);
+};
@@ -1,4 +1,14 @@
 #include "joypad.h"
+#include "mmu.h"
+
+void Joypad::connect_mmu(MMU* mmu) {
+    mmu->register_io(0x00, 0x00, this,
+        [](void* joypad, uint8_t reg) { return static_cast<Joypad*>(joypad)->get_joyp_state(); },
+        [](void* joypad, uint8_t reg, uint8_t value) {
+            // Only bits 4 and 5 are writable by the CPU
+            static_cast<Joypad*>(joypad)->control_mask = (value & 0x30);
+        });
+}
 
 uint8_t Joypad::get_joyp_state() {
     uint8_t res = 0xC0 | control_mask;
@@ -17,38 +27,17 @@ uint8_t Joypad::get_joyp_state() {
     return (res & 0xF0) | (buttons & 0x0F);
 }
 
-bool Joypad::handle_sdl_event(const SDL_Event& e) {
-    if (e.type != SDL_EVENT_KEY_DOWN && e.type != SDL_EVENT_KEY_UP) return false;
-
-    bool pressed = (e.type == SDL_EVENT_KEY_DOWN);
-    SDL_Keycode key = e.key.key;
-    bool interrupt_needed = false;
-
-    auto update_bit = [&](uint8_t& buttons, int bit, bool is_pressed) {
-        if (is_pressed) {
-            // If the button was previously NOT pressed (bit was 1), trigger interrupt
-            if (buttons & (1 << bit)) interrupt_needed = true;
-            buttons &= ~(1 << bit);
-        } else {
-            buttons |= (1 << bit);
-        }
-    };
+bool Joypad::set_button(Button button, bool pressed) {
+    uint8_t& buttons = (button >= BUTTON_A) ? action_buttons : direction_buttons;
+    int bit = button & 0x03;
 
-    switch (key) {
-        // Directions
-        case SDLK_RIGHT:  update_bit(direction_buttons, 0, pressed); break;
-        case SDLK_LEFT:   update_bit(direction_buttons, 1, pressed); break;
-        case SDLK_UP:     update_bit(direction_buttons, 2, pressed); break;
-        case SDLK_DOWN:   update_bit(direction_buttons, 3, pressed); break;
-
-        // Actions
-        case SDLK_Z:      update_bit(action_buttons, 0, pressed);    break; // A
-        case SDLK_X:      update_bit(action_buttons, 1, pressed);    break; // B
-        case SDLK_RSHIFT: update_bit(action_buttons, 2, pressed);    break; // Select
-        case SDLK_RETURN: update_bit(action_buttons, 3, pressed);    break; // Start
-
-        default: break;
+    if (pressed) {
+        // If the button was previously NOT pressed (bit was 1), trigger interrupt
+        bool interrupt_needed = (buttons & (1 << bit)) != 0;
+        buttons &= ~(1 << bit);
+        return interrupt_needed;
     }
 
-    return interrupt_needed;
-}
\ No newline at end of file
+    buttons |= (1 << bit);
+    return false;
+}
@@ -1,9 +1,19 @@
 #pragma once
 #include <cstdint>
-#include <SDL3/SDL.h>
+
+class MMU;
 
 class Joypad {
     public:
+        // Take over JOYP ($FF00)
+        void connect_mmu(MMU* mmu);
+
+        // Buttons, grouped by the nibble they live in
+        enum Button {
+            BUTTON_RIGHT, BUTTON_LEFT, BUTTON_UP, BUTTON_DOWN, // Direction buttons (bits 0-3)
+            BUTTON_A, BUTTON_B, BUTTON_SELECT, BUTTON_START,   // Action buttons (bits 0-3)
+        };
+
         // Button states (0 = pressed, 1 = released)
         uint8_t action_buttons = 0x0F;    // Start, Select, B, A
         uint8_t direction_buttons = 0x0F; // Down, Up, Left, Right
@@ -14,6 +24,6 @@ class Joypad {
         // Get current state of the joypad register ($FF00)
         uint8_t get_joyp_state();
 
-        // Handles SDL events and returns true if a Joypad Interrupt (bit 4) should be requested
-        bool handle_sdl_event(const SDL_Event& event);
-};
\ No newline at end of file
+        // Updates a button state and returns true if a Joypad Interrupt (bit 4) should be requested
+        bool set_button(Button button, bool pressed);
+};
@@ -0,0 +1,380 @@
+#include "mbc.h"
+#include "rom.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    // Host wall clock, which the MBC3 RTC is derived from
+    int64_t host_seconds() {
+        using namespace std::chrono;
+        return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+    // Little endian fields of the MBC3 clock footer
+    uint64_t load_le(const uint8_t* bytes, int size) {
+        uint64_t value = 0;
+        for (int i = size - 1; i >= 0; i--) {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+
+    void store_le(uint8_t* bytes, uint64_t value, int size) {
+        for (int i = 0; i < size; i++) {
+            bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+        }
+    }
+}
+
+std::unique_ptr<MBC> MBC::create(const uint8_t* rom, size_t size) {
+    if (size <= ROM::OFFSET_RAM_SIZE) return nullptr;
+
+    // External RAM size by header code - a 2 KB chip is mirrored four times across $A000-$BFFF (see get_ram_window_size())
+    static const size_t RAM_SIZES[6] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+    uint8_t ram_code = rom[ROM::OFFSET_RAM_SIZE];
+    size_t ram_size = (ram_code < 6) ? RAM_SIZES[ram_code] : 0;
+
+    switch (rom[ROM::OFFSET_TYPE]) {
+        case ROM::ROM_PLAIN:
+            return std::make_unique<ROMOnly>(rom, size, 0);
+        case ROM::ROM_RAM:
+        case ROM::ROM_RAM_BATTERY:
+            return std::make_unique<ROMOnly>(rom, size, ram_size);
+
+        case ROM::ROM_MBC1:
+        case ROM::ROM_MBC1_RAM:
+        case ROM::ROM_MBC1_RAM_BATT:
+            return std::make_unique<MBC1>(rom, size, ram_size);
+
+        case ROM::ROM_MBC3_TIMER_BATT:
+        case ROM::ROM_MBC3_TIMER_RAM_BATT:
+            return std::make_unique<MBC3>(rom, size, ram_size, true);
+        case ROM::ROM_MBC3:
+        case ROM::ROM_MBC3_RAM:
+        case ROM::ROM_MBC3_RAM_BATT:
+            return std::make_unique<MBC3>(rom, size, ram_size, false);
+
+        case ROM::ROM_MBC5:
+        case ROM::ROM_MBC5_RAM:
+        case ROM::ROM_MBC5_RAM_BATT:
+            return std::make_unique<MBC5>(rom, size, ram_size, false);
+        case ROM::ROM_MBC5_RUMBLE:
+        case ROM::ROM_MBC5_RUMBLE_SRAM:
+        case ROM::ROM_MBC5_RUMBLE_SRAM_BATT:
+            return std::make_unique<MBC5>(rom, size, ram_size, true);
+
+        default:
+            return nullptr;
+    }
+}
+
+MBC::MBC(const uint8_t* rom, size_t rom_size, size_t ram_size) : rom(rom) {
+    rom_banks_count = std::max<size_t>((rom_size + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE, 1);
+
+    if (rom_size != rom_banks_count * ROM_BANK_SIZE) {
+        padded_rom.resize(rom_banks_count * ROM_BANK_SIZE);
+        for (size_t i = 0; i < padded_rom.size(); i++) {
+            padded_rom[i] = rom[i % rom_size];
+        }
+        this->rom = padded_rom.data();
+    }
+
+    if (ram_size > 0) {
+        ram_buffer.resize(ram_size, 0);
+        ram = ram_buffer.data();
+        this->ram_size = ram_buffer.size();
+    }
+
+    map_rom(0, 0);
+    map_rom(1, 1);
+}
+
+void MBC::map_rom(int window, uint16_t bank) {
+    if (rom_windows[window] && rom_banks[window] == bank) return;
+
+    window_changes |= ROM_WINDOWS_CHANGED;
+    rom_banks[window] = bank;
+    rom_windows[window] = rom + (bank % rom_banks_count) * ROM_BANK_SIZE;
+}
+
+void MBC::map_ram(bool enabled, uint8_t bank) {
+    if (save && ram_mapped && !enabled) {
+        save->request_flush();
+    }
+
+    ram_mapped = enabled;
+    ram_mapped_bank = bank;
+
+    size_t banks = std::max<size_t>(ram_size / RAM_BANK_SIZE, 1);
+    uint8_t* window = (enabled && ram) ? ram + (bank % banks) * RAM_BANK_SIZE : nullptr;
+    if (window != ram_window) {
+        window_changes |= RAM_WINDOW_CHANGED;
+        ram_window = window;
+    }
+}
+
+uint8_t MBC::take_window_changes() {
+    uint8_t changes = window_changes;
+    window_changes = WINDOWS_UNCHANGED;
+    return changes;
+}
+
+bool MBC::attach_save(const char* filename) {
+    size_t footer_size = get_footer_size();
+    if (!ram && footer_size == 0) return false;
+
+    bool created = false;
+    std::unique_ptr<SaveFile> file = SaveFile::open(filename, ram_size + footer_size, created);
+    if (!file) return false;
+
+    if (created && ram) {
+        std::copy(ram, ram + ram_size, file->get_data());
+    }
+
+    save = std::move(file);
+    if (ram) {
+        ram = save->get_data();
+        ram_buffer.clear();
+        ram_buffer.shrink_to_fit();
+        map_ram(ram_mapped, ram_mapped_bank);
+    }
+
+    if (footer_size > 0) {
+        attach_footer(save->get_data() + ram_size);
+    }
+
+    return true;
+}
+
+void MBC::flush_save() {
+    if (save) {
+        save->request_flush();
+    }
+}
+
+ROMOnly::ROMOnly(const uint8_t* rom, size_t rom_size, size_t ram_size) : MBC(rom, rom_size, ram_size) {
+    map_ram(true, 0);
+}
+
+uint8_t ROMOnly::write_register(uint16_t address, uint8_t value) {
+    // Nothing to switch
+    return WINDOWS_UNCHANGED;
+}
+
+MBC1::MBC1(const uint8_t* rom, size_t rom_size, size_t ram_size) : MBC(rom, rom_size, ram_size) {
+    update_windows();
+}
+
+uint8_t MBC1::write_register(uint16_t address, uint8_t value) {
+    if (address <= 0x1FFF) {
+        // RAM Enable/Disable
+        ram_enabled = ((value & 0x0F) == 0x0A);
+    } else if (address <= 0x3FFF) {
+        // ROM Bank Number (Lower 5 bits)
+        rom_bank = value & 0x1F;
+        if (rom_bank == 0) rom_bank = 1;
+    } else if (address <= 0x5FFF) {
+        // RAM Bank Number / Upper Bits of ROM Bank Number
+        ram_bank = value & 0x03;
+    } else {
+        // Banking Mode Select
+        banking_mode = value & 0x01;
+    }
+
+    update_windows();
+
+    return take_window_changes();
+}
+
+void MBC1::update_windows() {
+    // Mode 1 also applies the upper bank bits to $0000-$3FFF, mode 0 only to the switchable bank
+    map_rom(0, (banking_mode == 1) ? (ram_bank << 5) : 0);
+    map_rom(1, (banking_mode == 0) ? (rom_bank | (ram_bank << 5)) : rom_bank);
+
+    // Mode 0 restricts RAM to bank 0
+    map_ram(ram_enabled, (banking_mode == 1) ? ram_bank : 0);
+}
+
+MBC3::MBC3(const uint8_t* rom, size_t rom_size, size_t ram_size, bool has_rtc)
+    : MBC(rom, rom_size, ram_size), has_rtc(has_rtc) {
+    rtc_base = host_seconds();
+    update_windows();
+}
+
+uint8_t MBC3::write_register(uint16_t address, uint8_t value) {
+    if (address <= 0x1FFF) {
+        // RAM and RTC Enable/Disable
+        ram_enabled = ((value & 0x0F) == 0x0A);
+    } else if (address <= 0x3FFF) {
+        // ROM Bank Number (7 bits)
+        rom_bank = value & 0x7F;
+        if (rom_bank == 0) rom_bank = 1;
+    } else if (address <= 0x5FFF) {
+        // RAM Bank Number / RTC Register Select
+        ram_select = value;
+    } else {
+        // Latch Clock Data - on a $00 -> $01 sequence
+        if (has_rtc && last_latch_write == 0x00 && value == 0x01) {
+            read_rtc(rtc_latched);
+            store_rtc();
+        }
+        last_latch_write = value;
+    }
+
+    update_windows();
+
+    return take_window_changes();
+}
+
+uint8_t MBC3::read_ram(uint16_t address) {
+    // Only RTC registers get here while enabled - RAM banks are mapped
+    int selected = get_selected_rtc_register();
+    if (!ram_enabled || selected == RTC_REGISTER_COUNT) return 0xFF;
+
+    return rtc_latched[selected];
+}
+
+void MBC3::write_ram(uint16_t address, uint8_t value) {
+    int selected = get_selected_rtc_register();
+    if (!ram_enabled || selected == RTC_REGISTER_COUNT) return;
+
+    // Writes go to the live clock - split it up, replace one field and turn it back into a second count
+    uint8_t registers[RTC_REGISTER_COUNT];
+    read_rtc(registers);
+    registers[selected] = value;
+    write_rtc(registers);
+
+    // The written value reads back without another latch
+    rtc_latched[selected] = value;
+    store_rtc();
+}
+
+size_t MBC3::get_footer_size() const {
+    return has_rtc ? RTC_FOOTER_SIZE : 0;
+}
+
+void MBC3::attach_footer(uint8_t* footer) {
+    rtc_footer = footer;
+
+    // A zero timestamp means there is no clock in the file yet (a new save, or one written without a footer)
+    int64_t saved_at = static_cast<int64_t>(load_le(footer + 40, 8));
+    if (saved_at == 0) {
+        store_rtc();
+        return;
+    }
+
+    uint8_t registers[RTC_REGISTER_COUNT];
+    for (int i = 0; i < RTC_REGISTER_COUNT; i++) {
+        registers[i] = static_cast<uint8_t>(load_le(footer + i * 4, 4));
+        rtc_latched[i] = static_cast<uint8_t>(load_le(footer + (RTC_REGISTER_COUNT + i) * 4, 4));
+    }
+    write_rtc(registers);
+
+    // A running clock kept counting while the emulator was closed
+    if (!rtc_halted) {
+        rtc_base -= std::max<int64_t>(host_seconds() - saved_at, 0);
+    }
+}
+
+void MBC3::store_rtc() {
+    if (!rtc_footer) return;
+
+    uint8_t registers[RTC_REGISTER_COUNT];
+    read_rtc(registers);
+
+    for (int i = 0; i < RTC_REGISTER_COUNT; i++) {
+        store_le(rtc_footer + i * 4, registers[i], 4);
+        store_le(rtc_footer + (RTC_REGISTER_COUNT + i) * 4, rtc_latched[i], 4);
+    }
+    store_le(rtc_footer + 40, static_cast<uint64_t>(host_seconds()), 8);
+}
+
+int MBC3::get_selected_rtc_register() const {
+    if (!has_rtc || ram_select < RTC_SELECT || ram_select >= RTC_SELECT + RTC_REGISTER_COUNT) {
+        return RTC_REGISTER_COUNT;
+    }
+
+    return ram_select - RTC_SELECT;
+}
+
+int64_t MBC3::get_rtc_seconds() const {
+    return rtc_halted ? rtc_halted_at : host_seconds() - rtc_base;
+}
+
+void MBC3::set_rtc_seconds(int64_t seconds) {
+    if (rtc_halted) {
+        rtc_halted_at = seconds;
+    } else {
+        rtc_base = host_seconds() - seconds;
+    }
+}
+
+void MBC3::read_rtc(uint8_t registers[RTC_REGISTER_COUNT]) {
+    int64_t seconds = get_rtc_seconds();
+
+    // The 9-bit day counter wraps after 512 days and sets the (sticky) overflow flag
+    const int64_t WRAP = 512 * 86400;
+    if (seconds >= WRAP) {
+        rtc_day_overflow = true;
+        seconds %= WRAP;
+        set_rtc_seconds(seconds);
+    }
+
+    int64_t days = seconds / 86400;
+    registers[RTC_SECONDS] = seconds % 60;
+    registers[RTC_MINUTES] = (seconds / 60) % 60;
+    registers[RTC_HOURS] = (seconds / 3600) % 24;
+    registers[RTC_DAYS_LOW] = days & 0xFF;
+    registers[RTC_DAYS_HIGH] = ((days >> 8) & 0x01) | (rtc_halted ? 0x40 : 0x00) | (rtc_day_overflow ? 0x80 : 0x00);
+}
+
+void MBC3::write_rtc(const uint8_t registers[RTC_REGISTER_COUNT]) {
+    int64_t days = registers[RTC_DAYS_LOW] | ((registers[RTC_DAYS_HIGH] & 0x01) << 8);
+    int64_t hours = days * 24 + (registers[RTC_HOURS] & 0x1F);
+    int64_t minutes = hours * 60 + (registers[RTC_MINUTES] & 0x3F);
+    int64_t seconds = minutes * 60 + (registers[RTC_SECONDS] & 0x3F);
+
+    // Halting freezes the clock at this value, resuming continues counting from it
+    rtc_halted = registers[RTC_DAYS_HIGH] & 0x40;
+    rtc_day_overflow = registers[RTC_DAYS_HIGH] & 0x80;
+    set_rtc_seconds(seconds);
+}
+
+void MBC3::update_windows() {
+    map_rom(0, 0);
+    map_rom(1, rom_bank);
+
+    // RTC registers are served by read_ram()/write_ram()
+    map_ram(ram_enabled && ram_select <= 0x03, ram_select);
+}
+
+MBC5::MBC5(const uint8_t* rom, size_t rom_size, size_t ram_size, bool has_rumble)
+    : MBC(rom, rom_size, ram_size), has_rumble(has_rumble) {
+    update_windows();
+}
+
+uint8_t MBC5::write_register(uint16_t address, uint8_t value) {
+    if (address <= 0x1FFF) {
+        // RAM Enable/Disable
+        ram_enabled = ((value & 0x0F) == 0x0A);
+    } else if (address <= 0x2FFF) {
+        // ROM Bank Number (Lower 8 bits)
+        rom_bank = (rom_bank & 0x100) | value;
+    } else if (address <= 0x3FFF) {
+        // ROM Bank Number (Bit 8)
+        rom_bank = (rom_bank & 0xFF) | ((value & 0x01) << 8);
+    } else if (address <= 0x5FFF) {
+        // RAM Bank Number - bit 3 is the rumble motor instead on rumble cartridges
+        ram_bank = value & (has_rumble ? 0x07 : 0x0F);
+    }
+
+    update_windows();
+
+    return take_window_changes();
+}
+
+void MBC5::update_windows() {
+    map_rom(0, 0);
+    map_rom(1, rom_bank);
+    map_ram(ram_enabled, ram_bank);
+}
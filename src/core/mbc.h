@@ -0,0 +1,245 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "save_file.h"
+
+/**
+ * @brief Cartridge memory bank controller (MBC).
+ *
+ * The MBC decides which 16 KB ROM banks appear at $0000-$3FFF and $4000-$7FFF, and which external RAM bank (if any)
+ * appears at $A000-$BFFF. Games switch banks by writing to the ROM area, which ends up in write_register().
+ *
+ * Implementations resolve their bank registers into host pointers for the three windows whenever a register is
+ * written, so the MMU can map the windows straight into its page table and never looks at the cartridge type on a
+ * read. Adding a controller means subclassing MBC and returning it from MBC::create() for its header types.
+ *
+ * Bank numbers are wrapped to the cartridge size once, when a window is mapped, so even an 8 MB cartridge costs
+ * nothing extra per access.
+ */
+class MBC {
+    public:
+        // What a register write did to the windows, as bit flags
+        enum WindowChange : uint8_t {
+            WINDOWS_UNCHANGED = 0,
+            ROM_WINDOWS_CHANGED = 0x01,  // The code the CPU is running could have been switched out
+            RAM_WINDOW_CHANGED = 0x02
+        };
+
+        virtual ~MBC() = default;
+
+        // Controller for the cartridge type in the ROM header, nullptr if the type isn't supported
+        // The ROM data must outlive the controller
+        static std::unique_ptr<MBC> create(const uint8_t* rom, size_t size);
+
+        // Write to the ROM area ($0000-$7FFF)
+        // Returns the windows that now point somewhere else (WindowChange flags) - most writes leave them all alone
+        virtual uint8_t write_register(uint16_t address, uint8_t value) = 0;
+
+        // Host memory behind $0000-$3FFF (window 0) and $4000-$7FFF (window 1)
+        const uint8_t* get_rom_window(int window) const { return rom_windows[window]; }
+
+        // ROM bank mapped in a window
+        uint16_t get_rom_bank(int window) const { return rom_banks[window]; }
+
+        // Host memory behind $A000-$BFFF, nullptr while external RAM is disabled or the cartridge has none
+        uint8_t* get_ram_window() const { return ram_window; }
+
+        // Bytes behind the RAM window - 8 KB, or 2 KB on cartridges with a 2 KB chip, which repeats over the window
+        size_t get_ram_window_size() const { return std::min(ram_size, RAM_BANK_SIZE); }
+
+        // Accesses to $A000-$BFFF while the RAM window is unmapped - disabled RAM reads $FF and ignores writes, but
+        // controllers can also put registers there (e.g. the MBC3 clock)
+        virtual uint8_t read_ram(uint16_t address) { return 0xFF; }
+        virtual void write_ram(uint16_t address, uint8_t value) {}
+
+        // All of external RAM
+        uint8_t* get_ram() { return ram; }
+        size_t get_ram_size() const { return ram_size; }
+
+        // Back external RAM with a battery save file from now on - a new file starts out with the current RAM
+        // contents, an existing one replaces them. The RAM window moves, so it has to be mapped again afterwards
+        // Returns false if the cartridge has no RAM (and no clock to keep) or the file can't be mapped
+        bool attach_save(const char* filename);
+
+        // Have the save file written back to disk in the background, if there is one
+        void flush_save();
+    protected:
+        MBC(const uint8_t* rom, size_t rom_size, size_t ram_size);
+
+        // Point a ROM window at a bank - bank numbers past the end of the ROM wrap around
+        void map_rom(int window, uint16_t bank);
+
+        // Point the RAM window at a bank, or unmap it while RAM is disabled
+        // Games disable RAM once they are done saving, so unmapping it also flushes the save file
+        void map_ram(bool enabled, uint8_t bank);
+
+        // WindowChange flags for the map_rom()/map_ram() calls since the last call
+        uint8_t take_window_changes();
+
+        // Bytes the controller keeps in the save file after external RAM (e.g. the MBC3 clock), 0 for none
+        virtual size_t get_footer_size() const { return 0; }
+
+        // Called by attach_save() with the footer's place in the save file - a new file's footer is all zeroes
+        virtual void attach_footer(uint8_t* footer) {}
+    private:
+        static constexpr size_t ROM_BANK_SIZE = 0x4000;
+        static constexpr size_t RAM_BANK_SIZE = 0x2000;
+
+        const uint8_t* rom;
+        size_t rom_banks_count;
+
+        // Mirrored copy of a ROM that isn't a whole number of banks, so every window is 16 KB of valid memory
+        std::vector<uint8_t> padded_rom;
+
+        // External RAM - ram_buffer, or the save file's mapping once one is attached
+        std::vector<uint8_t> ram_buffer;
+        std::unique_ptr<SaveFile> save;
+        uint8_t* ram = nullptr;
+        size_t ram_size = 0;
+
+        // Last map_ram() arguments, to map the window again when the RAM moves
+        bool ram_mapped = false;
+        uint8_t ram_mapped_bank = 0;
+
+        const uint8_t* rom_windows[2] = { nullptr, nullptr };
+        uint16_t rom_banks[2] = { 0, 0 };
+        uint8_t* ram_window = nullptr;
+
+        uint8_t window_changes = WINDOWS_UNCHANGED;
+};
+
+/**
+ * @brief Cartridge without a bank controller - 32 KB of ROM, plus up to 8 KB of RAM that is always enabled.
+ */
+class ROMOnly : public MBC {
+    public:
+        ROMOnly(const uint8_t* rom, size_t rom_size, size_t ram_size);
+
+        uint8_t write_register(uint16_t address, uint8_t value) override;
+};
+
+/**
+ * @brief MBC1 - up to 2 MB of ROM and 32 KB of RAM.
+ *
+ * $0000-$1FFF: RAM enable ($0A in the low nibble)
+ * $2000-$3FFF: ROM bank, lower 5 bits (0 selects bank 1)
+ * $4000-$5FFF: RAM bank, or upper 2 bits of the ROM bank
+ * $6000-$7FFF: Banking mode (0 = ROM banking, 1 = RAM banking)
+ */
+class MBC1 : public MBC {
+    public:
+        MBC1(const uint8_t* rom, size_t rom_size, size_t ram_size);
+
+        uint8_t write_register(uint16_t address, uint8_t value) override;
+    private:
+        bool ram_enabled = false;
+        uint8_t rom_bank = 1;
+        uint8_t ram_bank = 0;
+        uint8_t banking_mode = 0;
+
+        void update_windows();
+};
+
+/**
+ * @brief MBC3 - up to 2 MB of ROM, 32 KB of RAM and an optional real-time clock (RTC).
+ *
+ * $0000-$1FFF: RAM and RTC enable ($0A in the low nibble)
+ * $2000-$3FFF: ROM bank, 7 bits (0 selects bank 1)
+ * $4000-$5FFF: RAM bank ($00-$03), or RTC register ($08-$0C) to show at $A000-$BFFF
+ * $6000-$7FFF: Latch clock ($00 then $01 copies the live clock into the readable registers)
+ *
+ * The clock is never ticked - it is the host time elapsed since a base timestamp, and only turned into seconds,
+ * minutes, hours and days when latched or written.
+ *
+ * With a save file attached, the clock goes in the 48-byte footer most emulators append to RAM: the live and the
+ * latched registers as 32-bit values, then the host time they were taken at as a 64-bit UNIX timestamp (all little
+ * endian). The footer is rewritten whenever the clock is latched or set, and a running clock catches up on the time
+ * that has passed when the save is loaded.
+ */
+class MBC3 : public MBC {
+    public:
+        MBC3(const uint8_t* rom, size_t rom_size, size_t ram_size, bool has_rtc);
+
+        uint8_t write_register(uint16_t address, uint8_t value) override;
+
+        uint8_t read_ram(uint16_t address) override;
+        void write_ram(uint16_t address, uint8_t value) override;
+    protected:
+        size_t get_footer_size() const override;
+        void attach_footer(uint8_t* footer) override;
+    private:
+        // RTC registers, selected by writing RTC_SELECT + register to $4000-$5FFF
+        enum RTCRegister {
+            RTC_SECONDS,
+            RTC_MINUTES,
+            RTC_HOURS,
+            RTC_DAYS_LOW,
+            RTC_DAYS_HIGH,  // Bit 0: day counter bit 8, bit 6: halt, bit 7: day counter overflow
+            RTC_REGISTER_COUNT
+        };
+        static const uint8_t RTC_SELECT = 0x08;
+        static const size_t RTC_FOOTER_SIZE = 48;
+
+        bool ram_enabled = false;
+        uint8_t rom_bank = 1;
+        uint8_t ram_select = 0;
+        uint8_t last_latch_write = 0xFF;
+
+        bool has_rtc;
+
+        // Clock value is host time - rtc_base while running, rtc_halted_at while halted (both in seconds)
+        int64_t rtc_base = 0;
+        int64_t rtc_halted_at = 0;
+        bool rtc_halted = false;
+        bool rtc_day_overflow = false;
+
+        // Register values as of the last latch
+        uint8_t rtc_latched[RTC_REGISTER_COUNT] = {};
+
+        // Clock footer in the save file, nullptr without one
+        uint8_t* rtc_footer = nullptr;
+
+        // Seconds counted by the clock so far
+        int64_t get_rtc_seconds() const;
+        void set_rtc_seconds(int64_t seconds);
+
+        // Split the live clock into register values
+        void read_rtc(uint8_t registers[RTC_REGISTER_COUNT]);
+
+        // Set the live clock from register values
+        void write_rtc(const uint8_t registers[RTC_REGISTER_COUNT]);
+
+        // Write the clock to the save file's footer, if there is one
+        void store_rtc();
+
+        // RTC register selected for $A000-$BFFF, RTC_REGISTER_COUNT if RAM (or nothing) is selected
+        int get_selected_rtc_register() const;
+
+        void update_windows();
+};
+
+/**
+ * @brief MBC5 - up to 8 MB of ROM and 128 KB of RAM.
+ *
+ * $0000-$1FFF: RAM enable ($0A in the low nibble)
+ * $2000-$2FFF: ROM bank, lower 8 bits (bank 0 can be selected)
+ * $3000-$3FFF: ROM bank, bit 8
+ * $4000-$5FFF: RAM bank ($00-$0F, bit 3 drives the motor on rumble cartridges)
+ */
+class MBC5 : public MBC {
+    public:
+        MBC5(const uint8_t* rom, size_t rom_size, size_t ram_size, bool has_rumble);
+
+        uint8_t write_register(uint16_t address, uint8_t value) override;
+    private:
+        bool ram_enabled = false;
+        uint16_t rom_bank = 1;
+        uint8_t ram_bank = 0;
+
+        bool has_rumble;
+
+        void update_windows();
+};
@@ -1,24 +1,26 @@
 #include "mmu.h"
 #include "cpu.h"
 #include "ppu.h"
-#include "joypad.h"
 #include "rom.h"
+#include "interrupts.h"
 #include <cstring>
 #include <iostream>
-#include <sstream>
-#include <stdexcept>
-#include <fstream> 
+#include <algorithm>
+#include <iterator>
 
 MMU::MMU() {
     // Initialize memory arrays and variables
-    memset(cart, 0, sizeof(cart));
     memset(vram, 0, sizeof(vram));
-    memset(eram, 0, sizeof(eram));
     memset(wram, 0, sizeof(wram));
     memset(oam, 0, sizeof(oam));
     memset(io, 0, sizeof(io));
     memset(hram, 0, sizeof(hram));
-    ie = 0;
+
+    map_pages();
+
+    // OAM DMA is the MMU's own - it takes over the bus
+    register_io(0x46, 0x46, this, nullptr,
+        [](void* mmu, uint8_t reg, uint8_t value) { static_cast<MMU*>(mmu)->start_dma(value); });
 }
 
 void MMU::connect_cpu(CPU* c) {
@@ -29,102 +31,268 @@ void MMU::connect_ppu(PPU* p) {
     ppu = p;
 }
 
-void MMU::connect_joypad(Joypad* j) {
-    joypad = j;
+void MMU::connect_interrupts(InterruptController* i) {
+    interrupts = i;
+
+    register_io(0x0F, 0x0F, interrupts,
+        [](void* interrupts, uint8_t reg) { return static_cast<InterruptController*>(interrupts)->get_if(); },
+        [](void* interrupts, uint8_t reg, uint8_t value) { static_cast<InterruptController*>(interrupts)->set_if(value); });
 }
 
-void MMU::connect_rom(ROM* r) {
-    rom = r;
+void MMU::connect_scheduler(Scheduler* s) {
+    scheduler = s;
 }
 
-bool MMU::load_game(const uint8_t* data, size_t size) {
-    // Clear cartridge memory
-    memset(cart, 0, sizeof(cart));
-    memset(eram, 0, sizeof(eram)); // Clear external RAM
-    
-    // Reset MBC1 state
-    mbc1_ram_enabled = false;
-    mbc1_rom_bank = 1;
-    mbc1_ram_bank = 0;
-    mbc1_banking_mode = 0;
-
-    // Copy as much as fits into the static array for fallback
-    size_t copy_size = (size < sizeof(cart)) ? size : sizeof(cart);
-    std::memcpy(cart, data, copy_size);
-    
+void MMU::register_io(uint8_t first, uint8_t last, void* context, IOReadHandler read, IOWriteHandler write) {
+    for (int reg = first; reg <= last; reg++) {
+        io_handlers[reg] = { context, read, write };
+    }
+}
+
+bool MMU::load_game(std::shared_ptr<const ROM> rom) {
+    // A fresh controller also means cleared external RAM and reset bank registers
+    std::unique_ptr<MBC> controller = MBC::create(rom->get_data(), rom->get_size());
+    if (!controller) {
+        std::cout << "[MMU] Unsupported or unimplemented cartridge type: 0x" << std::hex
+                  << static_cast<int>(rom->get_type()) << std::dec << std::endl;
+        return false;
+    }
+
+    // The controller points into the ROM's data, so the handle is held for as long as it is in use
+    mbc = std::move(controller);
+    cartridge = std::move(rom);
+    map_banks();
+
     return true;
 }
 
 bool MMU::load_save(const char* filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) return false;
+    if (!mbc || !mbc->attach_save(filename)) return false;
 
-    file.read(reinterpret_cast<char*>(eram), sizeof(eram));
-    file.close();
-    
-    std::cout << "[MMU] Loaded battery backup RAM from " << filename << std::endl;
+    // External RAM now lives in the file's mapping
+    map_banks();
+
+    std::cout << "[MMU] Battery backup RAM mapped from " << filename << std::endl;
     return true;
 }
 
-bool MMU::save_game(const char* filename) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file) return false;
+void MMU::flush_save() {
+    if (mbc) {
+        mbc->flush_save();
+    }
+}
+
+void MMU::map_pages() {
+    // Start with every page on the slow path
+    std::fill(std::begin(read_pages), std::end(read_pages), nullptr);
+    std::fill(std::begin(write_pages), std::end(write_pages), nullptr);
+    std::fill(std::begin(fetch_pages), std::end(fetch_pages), nullptr);
 
-    file.write(reinterpret_cast<const char*>(eram), sizeof(eram));
-    file.close();
+    map_range(0x8000, 0x2000, vram, nullptr);
+    map_range(0xC000, 0x2000, wram, wram);
+    map_range(0xE000, 0x1E00, wram, nullptr); // Echo RAM ($E000-$FDFF)
 
-    std::cout << "[MMU] Saved battery backup RAM to " << filename << std::endl;
-    return true;
+    // OAM and HRAM share their pages with unusable memory and I/O registers, so they stay on the slow path
+
+    map_banks();
 }
 
-uint8_t MMU::read_byte(uint16_t address) {
+void MMU::map_banks() {
+    // Without a cartridge, ROM and external RAM reads are open bus - see read_slow()
+    if (!mbc) {
+        code_banks[0] = code_banks[1] = 0;
+        map_range(0x0000, 0x8000, nullptr, nullptr);
+        map_range(0xA000, 0x2000, nullptr, nullptr);
+        return;
+    }
+
+    // ROM is never written directly - writes there are MBC commands
+    for (int window = 0; window < 2; window++) {
+        code_banks[window] = mbc->get_rom_bank(window);
+        map_range(window * 0x4000, 0x4000, mbc->get_rom_window(window), nullptr);
+    }
+
+    // Disabled or missing external RAM reads $FF and ignores writes, which read_slow()/write_slow() take care of
+    // A 2 KB chip is mapped four times over
+    uint8_t* ram = mbc->get_ram_window();
+    uint16_t ram_length = ram ? static_cast<uint16_t>(mbc->get_ram_window_size()) : 0x2000;
+    for (uint16_t start = 0xA000; start < 0xC000; start += ram_length) {
+        map_range(start, ram_length, ram, ram);
+    }
+
+    // A running transfer keeps its bus until it ends
+    if (dma_active) {
+        unmap_dma_bus();
+    }
+}
+
+void MMU::map_range(uint16_t start, uint16_t length, const uint8_t* read, uint8_t* write) {
+    for (int page = 0; page < length / PAGE_SIZE; page++) {
+        int index = (start >> PAGE_SHIFT) + page;
+        uint8_t watched = watched_pages[index];
+        read_pages[index] = (read && !(watched & WATCH_READ)) ? read + page * PAGE_SIZE : nullptr;
+        write_pages[index] = (write && !(watched & WATCH_WRITE)) ? write + page * PAGE_SIZE : nullptr;
+        fetch_pages[index] = (read && !(watched & WATCH_EXECUTE)) ? read + page * PAGE_SIZE : nullptr;
+    }
+}
+
+int MMU::add_watchpoint(uint16_t start, uint16_t end, uint8_t kinds, bool pause) {
+    int id = next_watchpoint_id++;
+    watchpoints.push_back({ id, start, end, kinds, pause });
+    update_watched_pages();
+    return id;
+}
+
+void MMU::remove_watchpoint(int id) {
+    watchpoints.erase(std::remove_if(watchpoints.begin(), watchpoints.end(),
+                                     [id](const Watchpoint& watchpoint) { return watchpoint.id == id; }),
+                      watchpoints.end());
+    update_watched_pages();
+}
+
+void MMU::clear_watchpoints() {
+    watchpoints.clear();
+    update_watched_pages();
+}
+
+void MMU::update_watched_pages() {
+    std::fill(std::begin(watched_pages), std::end(watched_pages), 0);
+    for (const Watchpoint& watchpoint : watchpoints) {
+        for (int page = watchpoint.start >> PAGE_SHIFT; page <= (watchpoint.end >> PAGE_SHIFT); page++) {
+            watched_pages[page] |= watchpoint.kinds;
+        }
+    }
+
+    map_pages();
+}
+
+void MMU::trap(WatchKind kind, uint16_t address, uint8_t value) {
+    for (const Watchpoint& watchpoint : watchpoints) {
+        if (!(watchpoint.kinds & kind) || address < watchpoint.start || address > watchpoint.end) continue;
+
+        if (cpu) {
+            cpu->record_watch_hit(kind, address, value);
+            if (watchpoint.pause) cpu->watch_paused = true;
+        }
+    }
+}
+
+void MMU::start_dma(uint8_t value) {
+    io[0x46] = value;
+
+    // Starting a transfer while one is running restarts it - the bus is given back first, so the source is real
+    if (dma_active) {
+        dma_active = false;
+        map_pages();
+    }
+
+    // Sources past work RAM ($E000-$FFFF) read work RAM, like echo RAM
+    dma_source = ((value >= 0xE0) ? value - 0x20 : value) << 8;
+
+    // Transfers start on a page boundary, so plain memory is a single copy
+    const uint8_t* page = read_pages[dma_source >> PAGE_SHIFT];
+    if (page) {
+        memcpy(dma_buffer, page, sizeof(dma_buffer));
+    } else {
+        for (uint16_t i = 0; i < sizeof(dma_buffer); i++) {
+            dma_buffer[i] = read_slow(dma_source + i);
+        }
+    }
+
+    if (!scheduler) {
+        write_oam(dma_buffer);
+        return;
+    }
+
+    dma_active = true;
+    dma_start_cycle = scheduler->get_cycle();
+    unmap_dma_bus();
+    scheduler->schedule(Scheduler::EVENT_DMA, dma_start_cycle + DMA_CYCLES);
+
+    if (cpu) cpu->notify_dma_start();
+}
+
+void MMU::finish_dma() {
+    if (!dma_active) return;
+
+    write_oam(dma_buffer);
+    dma_active = false;
+    map_pages();
+}
+
+void MMU::write_oam(const uint8_t* data) {
+    // Games copy their sprite table every frame, usually with few changes
+    for (uint8_t offset = 0; offset < sizeof(oam); offset += 4) {
+        if (memcmp(oam + offset, data + offset, 4) != 0) {
+            video_dirty.mark_oam(offset);
+        }
+    }
+
+    memcpy(oam, data, sizeof(oam));
+}
+
+void MMU::unmap_dma_bus() {
+    if (dma_source >= 0x8000 && dma_source <= 0x9FFF) {
+        map_range(0x8000, 0x2000, nullptr, nullptr);
+    } else {
+        map_range(0x0000, 0x8000, nullptr, nullptr);
+        map_range(0xA000, 0x5E00, nullptr, nullptr);
+    }
+}
+
+bool MMU::is_dma_conflict(uint16_t address) const {
+    // OAM is being written by the transfer, and the CPU's own side of the bus ($FF00-$FFFF) is always free
+    if (address >= 0xFF00) return false;
+    if (address >= 0xFE00) return true;
+
+    bool vram_source = (dma_source >= 0x8000 && dma_source <= 0x9FFF);
+    bool vram_address = (address >= 0x8000 && address <= 0x9FFF);
+    return vram_source == vram_address;
+}
+
+uint8_t MMU::get_dma_conflict_byte() const {
+    // One byte per 4 cycles
+    uint64_t index = (scheduler->get_cycle() - dma_start_cycle) / 4;
+    return dma_buffer[std::min<uint64_t>(index, sizeof(dma_buffer) - 1)];
+}
+
+uint8_t MMU::read_slow(uint16_t address) {
+    uint8_t value = read_memory(address);
+
+    if (watched_pages[address >> PAGE_SHIFT] & WATCH_READ) {
+        trap(WATCH_READ, address, value);
+    }
+
+    return value;
+}
+
+uint8_t MMU::fetch_slow(uint16_t address) {
+    uint8_t value = read_memory(address);
+
+    if (watched_pages[address >> PAGE_SHIFT] & WATCH_EXECUTE) {
+        trap(WATCH_EXECUTE, address, value);
+    }
+
+    return value;
+}
+
+uint8_t MMU::read_memory(uint16_t address) {
+    if (dma_active && is_dma_conflict(address)) {
+        return (address >= 0xFE00) ? 0xFF : get_dma_conflict_byte();
+    }
+
     // Find byte in memory map
     if (address <= 0x7FFF) {
-        // Cartridge ROM
-        if (rom && rom->data) {
-            uint8_t type = rom->data[ROM::OFFSET_TYPE];
-            if (type == ROM::ROM_MBC1 || type == ROM::ROM_MBC1_RAM || type == ROM::ROM_MBC1_RAM_BATT) {
-                if (address <= 0x3FFF) {
-                    // Bank 0 unless mode 1 selected
-                    uint8_t bank = 0;
-                    if (mbc1_banking_mode == 1) {
-                        bank = (mbc1_ram_bank << 5);
-                    }
-                    size_t offset = (bank * 0x4000) + address;
-                    return rom->data[offset % rom->size];
-                } else {
-                    // Bank 1-7F (switchable)
-                    uint8_t bank = mbc1_rom_bank; // Lower 5 bits
-                    // If Mode 0, include upper 2 bits from ram_bank
-                    if (mbc1_banking_mode == 0) {
-                        bank |= (mbc1_ram_bank << 5);
-                    }
-                    size_t offset = (bank * 0x4000) + (address - 0x4000);
-                    return rom->data[offset % rom->size];
-                }
-            }
-            // For non-MBC1 roms, just read directly
-            return rom->data[address % rom->size];
-        }
-        return cart[address];
+        // Cartridge ROM - only on the slow path while watched, open bus without a cartridge
+        return mbc ? mbc->get_rom_window(address >> 14)[address & 0x3FFF] : 0xFF;
     } else if (address <= 0x9FFF) {
         // VRAM
         return vram[address - 0x8000];
     } else if (address <= 0xBFFF) {
-        // External RAM
-        if (!mbc1_ram_enabled) {
-             return 0xFF; // Disabled RAM returns FF
-        }
-        
-        // Calculate RAM Bank
-        uint8_t bank = 0;
-        if (mbc1_banking_mode == 1) {
-            bank = mbc1_ram_bank;
-        }
-        // Mode 0 restricts to Bank 0, so bank remains 0
-        
-        size_t offset = (bank * 0x2000) + (address - 0xA000);
-        return eram[offset];
+        // External RAM - the bank controller handles it while the window is unmapped
+        if (!mbc) return 0xFF;
+        const uint8_t* ram = mbc->get_ram_window();
+        return ram ? ram[(address - 0xA000) & (mbc->get_ram_window_size() - 1)] : mbc->read_ram(address);
     } else if (address <= 0xDFFF) {
         // Work RAM
         return wram[address - 0xC000];
@@ -135,184 +303,114 @@ uint8_t MMU::read_byte(uint16_t address) {
         // Object Attribute Memory (OAM)
         return oam[address - 0xFE00];
     } else if (address >= 0xFF00 && address <= 0xFF7F) {
-        // Joypad (0xFF00)
-        if (address == 0xFF00) {
-            return joypad ? joypad->get_joyp_state() : 0xFF;
-        }   
-
-        // I/O Registers
-        if (address == 0xFF04 && cpu) {
-            return static_cast<uint8_t>(cpu->internal_counter >> 8);
-        }
-        
-        // PPU Registers read delegation
-        if (address >= 0xFF40 && address <= 0xFF47 && ppu) {
-            switch (address) {
-                case 0xFF40: return ppu->get_lcdc();
-                case 0xFF41: return ppu->get_stat();
-                case 0xFF42: return ppu->get_scy();
-                case 0xFF43: return ppu->get_scx();
-                case 0xFF44:
-                    // If LCD is off, LY returns 0
-                    if (!(ppu->get_lcdc() & 0x80)) return 0;
-                    return ppu->get_ly();
-                case 0xFF45: return ppu->get_lyc();
-                case 0xFF47: return ppu->get_bgp();
-            }
-        }
-        
-        return io[address - 0xFF00];
+        // I/O Registers - handled by the component that owns them, or plain storage
+        uint8_t reg = address & 0x7F;
+        const IOHandler& handler = io_handlers[reg];
+        return handler.read ? handler.read(handler.context, reg) : io[reg];
     } else if (address >= 0xFF80 && address <= 0xFFFE) {
         // High RAM
         return hram[address - 0xFF80];
     } else if (address == 0xFFFF) {
         // Interupt Enable Register
-        return ie;
+        return interrupts ? interrupts->get_ie() : 0x00;
     } else {
-        // Unusable memory area or not implemented (e.g. 0xFEA0 - 0xFEFF)
-        std::stringstream ss;
-        ss << "Attempted read of unusable memory area at 0x" << std::hex << address;
-        throw std::runtime_error("[MMU] " + ss.str());
+        // Unusable memory area (0xFEA0 - 0xFEFF)
+        if (cpu) cpu->raise_fault(Fault::FAULT_UNUSABLE_READ, address);
+        return 0xFF;
     }
 }
 
 void MMU::write_byte(uint16_t address, uint8_t value) {
-    // Special write cases (i.e. I/O registers, VRAM, etc)
-    // Joypad
-    if (address == 0xFF00) {
-        if (joypad) {
-            // Only bits 4 and 5 are writable by the CPU
-            joypad->control_mask = (value & 0x30);
-        }
+    uint8_t* page = write_pages[address >> PAGE_SHIFT];
+    if (!page) {
+        write_slow(address, value);
         return;
     }
 
-    // PPU
-    if (address >= 0xFF40 && address <= 0xFF47) {
-        // Always update the I/O memory map so reads (like in PPU::draw_scanline) get the correct value
-        io[address - 0xFF00] = value;
-
-        // STAT write needs special handling to preserve read-only bits
-        uint8_t current_stat = ppu->get_stat();
-        uint8_t writable_bits = value & 0x78;
-        uint8_t read_only_bits = current_stat & 0x07;
-
-        if (!ppu) return;
-        switch (address) {
-            case 0xFF40: ppu->set_lcdc(value); break;
-            case 0xFF41: 
-                // Only bits 3-6 are writable - bits 0-2 are read-only PPU status
-                ppu->set_stat(writable_bits | read_only_bits);
-                break;
-            case 0xFF42: ppu->set_scy(value);  break;
-            case 0xFF43: ppu->set_scx(value);  break;
-            case 0xFF44: ppu->reset_ly();      break;
-            case 0xFF45: ppu->set_lyc(value);  break;
-
-            // DMA Transfer (0xFF46)
-            case 0xFF46:
-                // Value written is the high byte of source address
-                for (int i = 0; i < 160; i++) {
-                    write_byte(0xFE00+i, read_byte((value << 8)+i));
-                } 
-                break;
-                
-            case 0xFF47: ppu->set_bgp(value);  break;
-        }
-        return;
-    }
+    page[address & (PAGE_SIZE - 1)] = value;
 
-    // DIV register (0xFF04)
-    if (address == 0xFF04) {
-        // Writing to DIV register resets it
-        cpu->sync_timer_on_div_write();
-        return;
-    }
+    // The byte may belong to a decoded block
+    if (cpu && cpu->block_cache.is_code(address)) cpu->notify_code_write(address);
+}
 
-    // TIMA (0xFF05)
-    if (address == 0xFF05) {
-        cpu->sync_timer_on_tima_write(value);
-        io[address - 0xFF00] = value;
-        return;
-    }
+void MMU::write_slow(uint16_t address, uint8_t value) {
+    write_memory(address, value);
 
-    // TMA (0xFF06)
-    if (address == 0xFF06) {
-        io[address - 0xFF00] = value;
-        if (cpu) cpu->sync_timer_on_tma_write(value);
-        return;
+    if (watched_pages[address >> PAGE_SHIFT] & WATCH_WRITE) {
+        trap(WATCH_WRITE, address, value);
     }
+}
 
-    // TAC (0xFF07)
-    if (address == 0xFF07) {
-        cpu->sync_timer_on_tac_write(value);
-        io[address - 0xFF00] = value;
+void MMU::write_memory(uint16_t address, uint8_t value) {
+    if (dma_active && is_dma_conflict(address)) {
         return;
     }
 
-    // Other bytes - find byte in memory map
     if (address <= 0x7FFF) {
         // Cartridge ROM is read-only directly, but used for MBC commands
-        if (rom && rom->data) {
-            uint8_t type = rom->data[ROM::OFFSET_TYPE];
-            
-            // Handle MBC1
-            if (type == ROM::ROM_MBC1 || type == ROM::ROM_MBC1_RAM || type == ROM::ROM_MBC1_RAM_BATT) {
-                if (address >= 0x0000 && address <= 0x1FFF) {
-                    // RAM Enable/Disable
-                    mbc1_ram_enabled = ((value & 0x0F) == 0x0A);
-                } else if (address >= 0x2000 && address <= 0x3FFF) {
-                    // ROM Bank Number (Lower 5 bits)
-                    mbc1_rom_bank = value & 0x1F;
-                    if (mbc1_rom_bank == 0) mbc1_rom_bank = 1;
-                } else if (address >= 0x4000 && address <= 0x5FFF) {
-                    // RAM Bank Number / Upper Bits of ROM Bank Number
-                    mbc1_ram_bank = value & 0x03;
-                } else if (address >= 0x6000 && address <= 0x7FFF) {
-                    // Banking Mode Select
-                    mbc1_banking_mode = value & 0x01;
+        if (mbc) {
+            uint8_t changes = mbc->write_register(address, value);
+
+            // Most writes re-select the banks that are already mapped (or only latch the MBC3 clock)
+            if (changes != MBC::WINDOWS_UNCHANGED) {
+                map_banks();
+
+                // A bank switch can swap out code the CPU is running
+                if ((changes & MBC::ROM_WINDOWS_CHANGED) && cpu) {
+                    cpu->notify_rom_bank_change();
                 }
             }
         }
     } else if (address <= 0x9FFF) {
-        // VRAM
-        vram[address - 0x8000] = value;
+        // VRAM - only writes that change a byte count as changes
+        uint16_t offset = address - 0x8000;
+        if (vram[offset] != value) {
+            vram[offset] = value;
+            video_dirty.mark_vram(offset);
+        }
     } else if (address <= 0xBFFF) {
-        // External RAM
-        if (mbc1_ram_enabled) {
-            uint8_t bank = 0;
-            if (mbc1_banking_mode == 1) {
-                bank = mbc1_ram_bank;
-            }
-            size_t offset = (bank * 0x2000) + (address - 0xA000);
-            eram[offset] = value;
+        // External RAM - the bank controller handles it while the window is unmapped
+        if (!mbc) return;
+        uint8_t* ram = mbc->get_ram_window();
+        if (ram) {
+            ram[(address - 0xA000) & (mbc->get_ram_window_size() - 1)] = value;
+        } else {
+            mbc->write_ram(address, value);
         }
     } else if (address <= 0xDFFF) {
         // Work RAM
         wram[address - 0xC000] = value;
+        if (cpu && cpu->block_cache.is_code(address)) cpu->notify_code_write(address);
     } else if (address <= 0xFDFF) {
         // Echo RAM (mirror of Work RAM)
         wram[address - 0xE000] = value;
+        if (cpu && cpu->block_cache.is_code(address - 0x2000)) cpu->notify_code_write(address - 0x2000);
     } else if (address <= 0xFE9F) {
         // Object Attribute Memory (OAM)
-        oam[address - 0xFE00] = value;
+        uint8_t offset = address - 0xFE00;
+        if (oam[offset] != value) {
+            oam[offset] = value;
+            video_dirty.mark_oam(offset);
+        }
     } else if (address <= 0xFEFF) {
-        // Unusable memory (0xFEA0 ... 0xFEFF)
-        // Writes to this area are ignored
+        // Unusable memory area (0xFEA0 - 0xFEFF) - the write is dropped
+        if (cpu) cpu->raise_fault(Fault::FAULT_UNUSABLE_WRITE, address);
     } else if (address <= 0xFF7F) {
-        // I/O Registers (general/unimplemented)
-        io[address - 0xFF00] = value;
+        // I/O Registers - handled by the component that owns them, or plain storage
+        uint8_t reg = address & 0x7F;
+        const IOHandler& handler = io_handlers[reg];
+        if (handler.write) {
+            handler.write(handler.context, reg, value);
+        } else {
+            io[reg] = value;
+        }
     } else if (address <= 0xFFFE) {
         // High RAM
         hram[address - 0xFF80] = value;
+        if (cpu && cpu->block_cache.is_code(address)) cpu->notify_code_write(address);
     } else if (address == 0xFFFF) {
         // Interupt Enable Register
-        ie = value;
-    } else {
-        // Unusable memory area or not implemented
-        std::stringstream ss;
-        ss << "Attempted write to unusable memory area at 0x" << std::hex << address;
-        throw std::runtime_error("[MMU] " + ss.str());
+        if (interrupts) interrupts->set_ie(value);
     }
 }
 
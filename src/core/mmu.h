@@ -4,11 +4,16 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <memory>
+#include <vector>
+#include "mbc.h"
+#include "rom.h"
+#include "scheduler.h"
+#include "video_dirty.h"
 
 class CPU;
 class PPU;
-class Joypad;
-class ROM;
+class InterruptController;
 
 /**
  * @brief Implements the Game Boy's Memory Management Unit (MMU).alignas
@@ -39,38 +44,202 @@ class MMU {
         PPU* ppu = nullptr;
         void connect_ppu(PPU* p);
 
-        Joypad* joypad = nullptr;
-        void connect_joypad(Joypad* j);
+        // IF ($FF0F) and IE ($FFFF) live in the interrupt controller
+        InterruptController* interrupts = nullptr;
+        void connect_interrupts(InterruptController* i);
 
-        ROM* rom = nullptr;
-        void connect_rom(ROM* r);
+        // Master clock OAM DMA transfers are timed by (without one, a transfer completes as soon as it starts)
+        Scheduler* scheduler = nullptr;
+        void connect_scheduler(Scheduler* s);
 
-        uint8_t read_byte(uint16_t address);
+        // The address space is mapped in 256-byte pages
+        static const int PAGE_SHIFT = 8;
+        static const int PAGE_SIZE = 1 << PAGE_SHIFT;
+        static const int NUM_PAGES = 0x10000 >> PAGE_SHIFT;
+
+        // Plain memory is read straight through the page table, everything else takes the full memory map
+        uint8_t read_byte(uint16_t address) {
+            const uint8_t* page = read_pages[address >> PAGE_SHIFT];
+            return page ? page[address & (PAGE_SIZE - 1)] : read_slow(address);
+        }
         void write_byte(uint16_t address, uint8_t value);
 
+        // Instruction bytes - like read_byte(), but these are what execute watchpoints see (and read watchpoints don't)
+        uint8_t fetch_byte(uint16_t address) {
+            const uint8_t* page = fetch_pages[address >> PAGE_SHIFT];
+            return page ? page[address & (PAGE_SIZE - 1)] : fetch_slow(address);
+        }
+
         uint16_t read_word(uint16_t address);
+
+        // Raw access to an I/O register ($FF00 + reg) without any of the side effects of read_byte/write_byte
+        // For the component that owns the register, e.g. the timers updating TIMA and IF while they catch up
+        uint8_t get_io(uint8_t reg) const { return io[reg]; }
+        void set_io(uint8_t reg, uint8_t value) { io[reg] = value; }
+
+        // Handlers for CPU accesses to an I/O register, called with the context they were registered with
+        using IOReadHandler = uint8_t (*)(void* context, uint8_t reg);
+        using IOWriteHandler = void (*)(void* context, uint8_t reg, uint8_t value);
+
+        // Route CPU accesses to the I/O registers first..last ($FF00 + reg) to the component that owns them
+        // Components register at connect time - a nullptr handler leaves that direction as plain storage in io[]
+        void register_io(uint8_t first, uint8_t last, void* context, IOReadHandler read, IOWriteHandler write);
+
+        // ROM bank currently mapped at an address (0 for anything outside $0000-$7FFF)
+        // Used to key decoded code, so blocks from different banks at the same address don't collide
+        uint16_t get_code_bank(uint16_t address) const {
+            return (address <= 0x7FFF) ? code_banks[address >> 14] : 0;
+        }
         void write_word(uint16_t address, uint16_t value);
-        
-        bool load_game(const uint8_t* data, size_t size);
+
+        // OAM DMA ($FF46) - 160 bytes are copied to OAM over DMA_CYCLES. Meanwhile OAM reads $FF, and accesses to the
+        // bus the transfer reads from (VRAM, or the cartridge/work RAM bus for everything else) see the byte being
+        // transferred instead of memory, while writes there are lost. I/O and HRAM stay usable - DMA routines run
+        // from HRAM
+        static const uint32_t DMA_CYCLES = 640;
+        bool is_dma_active() const { return dma_active; }
+
+        // Cached blocks and compiled code see neither DMA bus conflicts nor watchpoints, so the CPU interprets while
+        // either is in play
+        bool requires_interpreter() const { return dma_active || !watchpoints.empty(); }
+
+        // Copy the transfer into OAM and give the bus back - on EVENT_DMA
+        void finish_dma();
+
+        // Which VRAM tiles, tile map rows and OAM entries have changed - consumers clear what they have caught up on
+        VideoDirtyTracker& get_video_dirty() { return video_dirty; }
+        const VideoDirtyTracker& get_video_dirty() const { return video_dirty; }
+
+        // VRAM and OAM as the PPU sees them ($8000/$FE00 + offset) - no DMA conflicts or watchpoints, unlike read_byte()
+        const uint8_t* get_vram() const { return vram; }
+        const uint8_t* get_oam() const { return oam; }
+
+        // Insert a cartridge and set up its bank controller - returns false (keeping the current cartridge) if its
+        // type isn't supported
+        bool load_game(std::shared_ptr<const ROM> rom);
+
+        // Cartridge currently inserted, nullptr if there is none
+        const std::shared_ptr<const ROM>& get_rom() const { return cartridge; }
+
+        // Keep the cartridge's external RAM in a battery save file - writes go straight to the file, so there is
+        // nothing to save on exit. Returns false if the cartridge has no RAM or the file can't be mapped
         bool load_save(const char* filename);
-        bool save_game(const char* filename);
+
+        // Write the save file back to disk in the background
+        void flush_save();
+
+        // Watchpoints - accesses to a watched range are recorded in CPU::watch_hits, and a pausing watchpoint sets
+        // CPU::watch_paused once it is hit. Watched pages are taken out of the page table and trapped on the slow path,
+        // so every other page keeps its full speed, and nothing is checked while no watchpoint is set
+        enum WatchKind : uint8_t {
+            WATCH_READ = 0x01,
+            WATCH_WRITE = 0x02,
+            WATCH_EXECUTE = 0x04    // Fetching instruction bytes
+        };
+
+        // Watch start..end (inclusive) for a combination of WatchKinds - returns an id for remove_watchpoint()
+        int add_watchpoint(uint16_t start, uint16_t end, uint8_t kinds, bool pause);
+        void remove_watchpoint(int id);
+        void clear_watchpoints();
 
         // Debug functions to dump HRAM/VRAM contents
         void dump_hram();
         void dump_vram();
     private:
-        unsigned char cart[0x8000]; // 32 KB total cartridge ROM space
+        // Compiled code reads and writes WRAM/HRAM directly
+        friend class JIT;
+
         unsigned char vram[0x2000]; // 8 KB of video RAM (VRAM)
-        unsigned char eram[0x8000]; // 32 KB of external RAM (cartridge battery-backed RAM) - Supports up to 4 banks for MBC1
         unsigned char wram[0x2000]; // 8 KB of work RAM (WRAM). In CGB mode, this is switchable banks 1-7
         unsigned char oam[0xA0];    // 160 bytes for sprite attribute memory (OAM)
         unsigned char io[0x80];     // 128 bytes for I/O registers
         unsigned char hram[0x7F];   // 127 bytes for high RAM
-        uint8_t ie;                 // Interrupt Enable register (IE) at 0xFFFF
 
-        // MBC1 specific state
-        bool mbc1_ram_enabled = false;
-        uint8_t mbc1_rom_bank = 1;      
-        uint8_t mbc1_ram_bank = 0;
-        uint8_t mbc1_banking_mode = 0;  // 0 = ROM banking mode, 1 = RAM banking mode
+        struct IOHandler {
+            void* context = nullptr;
+            IOReadHandler read = nullptr;
+            IOWriteHandler write = nullptr;
+        };
+
+        // Changes to vram and oam - VRAM is only mapped for reads, so every write reaches write_slow() to be tracked
+        VideoDirtyTracker video_dirty;
+
+        // Owner of each I/O register, indexed by reg ($FF00 + reg)
+        IOHandler io_handlers[0x80];
+
+        // OAM DMA in progress - the source is read into dma_buffer up front, as nothing can change it until the
+        // transfer ends
+        bool dma_active = false;
+        uint16_t dma_source = 0;
+        uint64_t dma_start_cycle = 0;
+        uint8_t dma_buffer[0xA0];
+
+        void start_dma(uint8_t value);
+
+        // Replace all of OAM, marking the entries that change
+        void write_oam(const uint8_t* data);
+
+        // Unmap the pages on the bus the transfer is using, so CPU accesses there reach read_slow()/write_slow()
+        void unmap_dma_bus();
+
+        // True if a CPU access to address collides with the running transfer
+        bool is_dma_conflict(uint16_t address) const;
+
+        // Byte the transfer is moving this cycle - what a colliding read sees
+        uint8_t get_dma_conflict_byte() const;
+
+        // Host memory behind each page, nullptr where accesses need handling (I/O, MBC registers, disabled external
+        // RAM, ...)
+        // Echo RAM is only mapped for reads, so writes through it still reach the block cache's code tracking - the same
+        // goes for VRAM and its dirty tracking
+        const uint8_t* read_pages[NUM_PAGES];
+        uint8_t* write_pages[NUM_PAGES];
+
+        // read_pages, minus the pages watched for execution
+        const uint8_t* fetch_pages[NUM_PAGES];
+
+        struct Watchpoint {
+            int id;
+            uint16_t start;
+            uint16_t end;
+            uint8_t kinds;
+            bool pause;
+        };
+
+        std::vector<Watchpoint> watchpoints;
+        int next_watchpoint_id = 0;
+
+        // WatchKinds with a watchpoint somewhere in each page - those directions are kept out of the page table
+        uint8_t watched_pages[NUM_PAGES] = {};
+
+        // Rebuild watched_pages and the page table after the watchpoints change
+        void update_watched_pages();
+
+        // Check an access to a watched page against the watchpoints, recording any hits
+        void trap(WatchKind kind, uint16_t address, uint8_t value);
+
+        // ROM banks reported by get_code_bank() for $0000-$3FFF and $4000-$7FFF
+        uint16_t code_banks[2] = { 0, 0 };
+
+        // Full memory map, for pages without a host pointer - plus watchpoint traps
+        uint8_t read_slow(uint16_t address);
+        void write_slow(uint16_t address, uint8_t value);
+        uint8_t fetch_slow(uint16_t address);
+
+        // The memory map itself
+        uint8_t read_memory(uint16_t address);
+        void write_memory(uint16_t address, uint8_t value);
+
+        // Point every page at the memory currently mapped there
+        void map_pages();
+
+        // Remap the cartridge ROM and external RAM pages after the cartridge or a bank register changes
+        void map_banks();
+
+        // Map length bytes from start to host memory (nullptr leaves them on the slow path, as do watchpoints)
+        void map_range(uint16_t start, uint16_t length, const uint8_t* read, uint8_t* write);
+
+        // Cartridge and its bank controller, nullptr until a game is loaded
+        std::shared_ptr<const ROM> cartridge;
+        std::unique_ptr<MBC> mbc;
 };
@@ -1,5 +1,6 @@
 #include "ppu.h"
 #include <cstring>
+#include <algorithm>
 
 PPU::PPU() {
     // Initialize registers to Post-Boot ROM defaults
@@ -20,32 +21,89 @@ PPU::PPU() {
 
 void PPU::connect_mmu(MMU* m) {
     mmu = m;
+
+    // $FF46 (OAM DMA) in between belongs to the MMU
+    MMU::IOReadHandler read = [](void* ppu, uint8_t reg) { return static_cast<PPU*>(ppu)->read_register(reg); };
+    MMU::IOWriteHandler write = [](void* ppu, uint8_t reg, uint8_t value) { static_cast<PPU*>(ppu)->write_register(reg, value); };
+    mmu->register_io(0x40, 0x45, this, read, write);
+    mmu->register_io(0x47, 0x47, this, read, write);
+}
+
+uint8_t PPU::read_register(uint8_t reg) {
+    switch (reg) {
+        case 0x40: return lcdc;
+        case 0x41: return stat;
+        case 0x42: return scy;
+        case 0x43: return scx;
+        case 0x44:
+            // If LCD is off, LY returns 0
+            if (!(lcdc & 0x80)) return 0;
+            return current_ly;
+        case 0x45: return lyc;
+        default:   return bgp;
+    }
+}
+
+void PPU::write_register(uint8_t reg, uint8_t value) {
+    // Always update the I/O memory map too
+    mmu->set_io(reg, value);
+
+    // LCDC, STAT, LY and LYC change what the PPU does next - bring it up to date first, and re-evaluate LY=LYC and
+    // the mode once this instruction is done
+    bool affects_timing = (reg == 0x40 || reg == 0x41 || reg == 0x44 || reg == 0x45);
+    if (affects_timing) {
+        sync();
+    }
+
+    switch (reg) {
+        case 0x40: set_lcdc(value); break;
+        case 0x41: set_stat(value); break; // Bits 0-2 are read-only PPU status
+        case 0x42: set_scy(value);  break;
+        case 0x43: set_scx(value);  break;
+        case 0x44: reset_ly();      break;
+        case 0x45: set_lyc(value);  break;
+        case 0x47: set_bgp(value);  break;
+    }
+
+    if (affects_timing) {
+        schedule_sync();
+    }
 }
 
-void PPU::init_sdl() {
-    SDL_Init(SDL_INIT_VIDEO);
+void PPU::connect_interrupts(InterruptController* i) {
+    interrupts = i;
+}
 
-    // Initialize the window. Render at 2x scale for visibility
-    window = SDL_CreateWindow("GameByte", (160*2), (144*2), 0);
-    renderer = SDL_CreateRenderer(window, nullptr);
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 160, 144);
-    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+void PPU::connect_scheduler(Scheduler* s) {
+    scheduler = s;
+    synced_cycle = scheduler->get_cycle();
+    schedule_sync();
 }
 
-void PPU::render_frame() {
-    SDL_UpdateTexture(texture, NULL, framebuffer, 160 * sizeof(uint32_t));
-    SDL_RenderClear(renderer);
-    SDL_RenderTexture(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+void PPU::sync() {
+    if (!scheduler) return;
+
+    uint64_t elapsed = scheduler->get_cycle() - synced_cycle;
+    synced_cycle = scheduler->get_cycle();
+
+    // Nothing but the LCD-off reset happens while the LCD is off, however long that was
+    tick(static_cast<uint32_t>(std::min<uint64_t>(elapsed, UINT32_MAX)));
+
+    if (lcdc & 0x80) {
+        scheduler->schedule(Scheduler::EVENT_PPU, synced_cycle + cycles_until_event());
+    } else {
+        // Re-enabling the LCD (an LCDC write) schedules the next sync
+        scheduler->cancel(Scheduler::EVENT_PPU);
+    }
 }
 
-void PPU::render_blank() {
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-    SDL_RenderClear(renderer);
-    SDL_RenderPresent(renderer);
+void PPU::schedule_sync() {
+    if (scheduler) {
+        scheduler->schedule(Scheduler::EVENT_PPU, scheduler->get_cycle());
+    }
 }
 
-void PPU::tick(uint8_t cycles) {
+void PPU::tick(uint32_t cycles) {
     // Check if LCD is enabled (LCDC bit 7)
     if (!(lcdc & 0x80)) {
         // Reset PPU state when LCD is disabled
@@ -53,6 +111,14 @@ void PPU::tick(uint8_t cycles) {
         current_ly = 0;
         mode = 0;
         
+        // The next frame starts with the LCD, so decide on it when the LCD goes off (games often turn it off in
+        // V-blank, before LY wraps) - and draw it if one is asked for in the meantime
+        if (!first_frame_after_enable) {
+            begin_frame();
+        } else if (render_requested) {
+            drawing_frame = true;
+        }
+
         // Ensure STAT register reflects Mode 0 and clears coincidence bit
         stat &= ~0x07;
         first_frame_after_enable = true;
@@ -61,79 +127,133 @@ void PPU::tick(uint8_t cycles) {
 
     ppu_cycles += cycles;
 
-    switch (mode) {
-        // OAM search (80 cycles)
-        case 2: 
-            if (ppu_cycles >= 80) {
-                ppu_cycles -= 80;
-                mode = 3;
-            }
-            break;
+    // Large cycle counts (e.g. a whole decoded block) can cross more than one mode boundary, so keep
+    // stepping until the remaining cycles don't complete the current mode
+    bool mode_changed;
+    do {
+        uint8_t previous_mode = mode;
+        uint8_t previous_ly = current_ly;
+
+        switch (mode) {
+            // OAM search (80 cycles)
+            case 2: 
+                if (ppu_cycles >= 80) {
+                    ppu_cycles -= 80;
+                    mode = 3;
+                }
+                break;
         
-        // Pixel transfer (172 cycles, emulated as 168 for timing accuracy)
-        case 3:
-            if (ppu_cycles >= 168) {
-                ppu_cycles -= 168;
-                mode = 0;
-                draw_scanline(); // Draw the current line at the end of transfer
-            }
-            break;
+            // Pixel transfer (172 cycles, emulated as 168 for timing accuracy)
+            case 3:
+                if (ppu_cycles >= 168) {
+                    ppu_cycles -= 168;
+                    mode = 0;
+                    // Draw the current line at the end of transfer
+                    if (drawing_frame) {
+                        draw_scanline();
+                    } else {
+                        skip_scanline();
+                    }
+                }
+                break;
         
-        // H-blank (204 cycles, emulated as 208 for timing accuracy)
-        case 0:
-            if (ppu_cycles >= 208) {
-                ppu_cycles -= 208;
-                current_ly++;
-
-                if (current_ly == 144) {
-                    mode = 1; 
-                    request_interrupt(0); // V-blank Interrupt
-                    first_frame_after_enable = false;
-                } else {
-                    mode = 2; 
+            // H-blank (204 cycles, emulated as 208 for timing accuracy)
+            case 0:
+                if (ppu_cycles >= 208) {
+                    ppu_cycles -= 208;
+                    current_ly++;
+
+                    if (current_ly == 144) {
+                        mode = 1; 
+                        request_interrupt(0); // V-blank Interrupt
+                        first_frame_after_enable = false;
+
+                        frame_rendered = drawing_frame;
+                        if (drawing_frame) render_requested = false;
+                    } else {
+                        mode = 2; 
+                    }
                 }
-            }
-            break;
+                break;
         
-        // V-blank (456 cycles per line, 10 lines total)
-        case 1:
-            if (ppu_cycles >= 456) {
-                ppu_cycles -= 456;
-                current_ly++;
+            // V-blank (456 cycles per line, 10 lines total)
+            case 1:
+                if (ppu_cycles >= 456) {
+                    ppu_cycles -= 456;
+                    current_ly++;
                 
-                if (current_ly > 153) {
-                    // Reset to start of next frame
-                    current_ly = 0;
-                    window_line_counter = 0;
-                    mode = 2;
+                    if (current_ly > 153) {
+                        // Reset to start of next frame
+                        current_ly = 0;
+                        window_line_counter = 0;
+                        mode = 2;
+                        begin_frame();
+                    }
                 }
-            }
-            break;
-    }
+                break;
+        }
+
+        // Update the STAT register's bits 0-1
+        stat &= ~0x03;
+        stat |= (mode & 0x03);
 
-    // Update the STAT register's bits 0-1
-    stat &= ~0x03;
-    stat |= (mode & 0x03);
+        // Handle LYC == LY comparison (bit 2 of STAT)
+        if (current_ly == lyc) {
+            bool was_coincidence = (stat & 0x04);
+            stat |= 0x04;
+        
+            if (!was_coincidence && (stat & 0x40)) {
+                request_interrupt(1);
+            }
+        } else {
+            stat &= ~0x04;
+        }
 
-    // Handle LYC == LY comparison (bit 2 of STAT)
-    if (current_ly == lyc) {
-        bool was_coincidence = (stat & 0x04);
-        stat |= 0x04;
+        // Trigger STAT interrupt on mode changes
+        if (mode != last_mode) {
+            if (mode == 0 && (stat & 0x08)) request_interrupt(1);
+            if (mode == 1 && (stat & 0x10)) request_interrupt(1);
+            if (mode == 2 && (stat & 0x20)) request_interrupt(1);
         
-        if (!was_coincidence && (stat & 0x40)) {
-            request_interrupt(1);
+            last_mode = mode; // Update last_mode for the next tick
         }
+
+        mode_changed = (mode != previous_mode) || (current_ly != previous_ly);
+    } while (mode_changed);
+}
+
+uint32_t PPU::cycles_until_event() const {
+    if (!(lcdc & 0x80)) return UINT32_MAX;
+
+    // Length of each mode, indexed by mode number (H-blank, V-blank line, OAM search, pixel transfer)
+    static const uint16_t MODE_LENGTHS[4] = { 208, 456, 80, 168 };
+    uint16_t length = MODE_LENGTHS[mode & 0x03];
+
+    return (ppu_cycles < length) ? (length - ppu_cycles) : 0;
+}
+
+void PPU::begin_frame() {
+    if (render_requested) {
+        drawing_frame = true;
+    } else if (skip_requested || render_interval == 0) {
+        drawing_frame = false;
     } else {
-        stat &= ~0x04;
+        drawing_frame = (frames_skipped + 1 >= render_interval);
     }
 
-    // Trigger STAT interrupt on mode changes
-    if (mode != last_mode) {
-        if (mode == 0 && (stat & 0x08)) request_interrupt(1);
-        if (mode == 1 && (stat & 0x10)) request_interrupt(1);
-        if (mode == 2 && (stat & 0x20)) request_interrupt(1);
-        
-        last_mode = mode; // Update last_mode for the next tick
+    frames_skipped = drawing_frame ? 0 : frames_skipped + 1;
+    skip_requested = false;
+}
+
+void PPU::skip_scanline() {
+    uint8_t ly = current_ly;
+    if (ly >= 144 || first_frame_after_enable) return;
+
+    // Same conditions draw_scanline() draws the window under
+    uint8_t wy = mmu->get_io(0x4A);
+    uint8_t wx = mmu->get_io(0x4B) - 7;
+    if ((lcdc & 0x01) && (lcdc & 0x20) && ly >= wy && wx < 160) {
+        window_line_counter++;
     }
 }
 
@@ -143,174 +263,156 @@ void PPU::draw_scanline() {
 
     // Check if scanline is beyond visible area
     if (ly >= 144) return;
-    
-    uint8_t lcdc = mmu->read_byte(0xFF40);
-
-    // Get the background palette (BGP) at 0xFF47
-    uint8_t bgp = mmu->read_byte(0xFF47);
-    uint32_t shades[] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
 
     // If this is the first frame after LCD enable, fill with white
     if (first_frame_after_enable) {
-        for (int px = 0; px < 160; px++) {
-            framebuffer[ly * 160 + px] = shades[0];
-        }
+        memset(framebuffer + ly * 160, 0, 160);
         return; 
     }
 
-    // Sprite priority check
-    uint8_t bg_color_ids[160] = {0};
+    // Catch up on the tiles written since the last scanline
+    tile_cache.update(mmu->get_vram(), mmu->get_video_dirty());
+
+    // Color indices of this line, composed into the framebuffer once the sprites are in
+    memset(layers.obj, 0, sizeof(layers.obj));
+    memset(layers.obj_front, 0, sizeof(layers.obj_front));
 
     // Check master bg/window enable bit (LCDC bit 0)
     if (!(lcdc & 0x01)) {
-        // Fill scanline with white (color 0)
-        for (int px = 0; px < 160; px++) {
-            framebuffer[ly * 160 + px] = shades[0];
-        }
+        // Fill scanline with white (shade 0)
+        memset(framebuffer + ly * 160, 0, 160);
         return;
     } else {
-        // Window positions
-        uint8_t wy = mmu->read_byte(0xFF4A);
-        uint8_t wx = mmu->read_byte(0xFF4B) - 7;
+        // Window positions - read raw, so the PPU's own fetches never show up as CPU reads (e.g. to watchpoints)
+        uint8_t wy = mmu->get_io(0x4A);
+        uint8_t wx = mmu->get_io(0x4B) - 7;
         bool window_enabled = (lcdc & 0x20) && (ly >= wy);
         bool window_drawn = false;
 
-        // Get scroll (x and y) pos
-        uint8_t scy = mmu->read_byte(0xFF42);
-        uint8_t scx = mmu->read_byte(0xFF43);
+        // Background up to the window, window from there on
+        bool is_unsigned = (lcdc & 0x10);
+        int window_start = window_enabled ? std::min<int>(wx, 160) : 160;
+        draw_tiles(layers.bg, 0, window_start, (lcdc & 0x08) ? 0x1C00 : 0x1800, scx, ly + scy, is_unsigned); // LCDC bit 3
+        if (window_start < 160) {
+            draw_tiles(layers.bg, window_start, 160, (lcdc & 0x40) ? 0x1C00 : 0x1800, 0, window_line_counter, is_unsigned); // LCDC bit 6
+            window_drawn = true;
+        }
 
-        for (int px = 0; px < 160; px++) {
-            uint16_t map_base;
-            uint8_t t_x, t_y;
+        if (window_drawn) {
+            window_line_counter++;
+        }
+    }
 
-            // Decide if window or background
-            if (window_enabled && px >= wx) {
-                map_base = (lcdc & 0x40) ? 0x9C00 : 0x9800; // LCDC bit 6
-                t_x = px - wx;
-                t_y = window_line_counter;
-                window_drawn = true;
-            } else {
-                map_base = (lcdc & 0x08) ? 0x9C00 : 0x9800; // LCDC bit 3
-                t_x = px + scx;
-                t_y = ly + scy;
-            }
+    // Draw sprite(s) (10 max per line) on top of background - the OAM can't be read while a DMA transfer runs
+    if ((lcdc & 0x02) && !mmu->is_dma_active()) {
+        uint8_t sprite_height = (lcdc & 0x04) ? 16 : 8;
+        if (mmu->get_video_dirty().any_sprite_dirty() || sprite_height != bucket_height) {
+            build_sprite_buckets(sprite_height);
+        }
+
+        const uint8_t* oam = mmu->get_oam();
+        for (int i = 0; i < sprite_counts[ly]; i++) {
+            const uint8_t* sprite = oam + line_sprites[ly][i] * 4;
+            int sprite_y = sprite[0] - 16;
+            int sprite_x = sprite[1] - 8;
+            uint8_t tile_index = sprite[2];
+            uint8_t attributes = sprite[3];
+
+            // Determine which palette to use (Bit 4: 0=OBP0, 1=OBP1)
+            uint8_t palette = (attributes & 0x10) ? ScanlineCompositor::OBJ_OBP1 : ScanlineCompositor::OBJ_OBP0;
+            bool behind_bg = (attributes & 0x80) != 0;
 
-            uint16_t tile_row = (t_y / 8) * 32;
-            uint16_t tile_col = (t_x / 8);
-            uint8_t tile_index = mmu->read_byte(map_base + tile_row + tile_col);
+            // Fetch tile data (Sprites always use 0x8000-0x8FFF unsigned mode)
+            uint8_t tile;
+            uint8_t line = ly - sprite_y;
 
-            // Tile data addressing
-            bool is_unsigned = (lcdc & 0x10);
-            uint16_t tile_data_addr;
-            
-            if (is_unsigned) {
-                tile_data_addr = 0x8000 + (tile_index * 16);
+            // Handle vertical flip (Bit 6)
+            if (attributes & 0x40) line = (sprite_height - 1) - line;
+
+            if (sprite_height == 16) {
+                // For 8x16 sprites, bit 0 of the tile index is ignored for the base
+                uint8_t base_tile = tile_index & 0xFE;
+                tile = (line < 8) ? base_tile : (base_tile | 0x01);
+
+                // Reset line to 0-7 for the specific 8x8 tile selected
+                line %= 8;
             } else {
-                int16_t rel_address = static_cast<int8_t>(tile_index) * 16;
-                tile_data_addr = static_cast<uint16_t>(0x9000 + rel_address);
+                // Standard 8x8 mode
+                tile = tile_index;
             }
 
-            // Fetch pixel bits
-            uint8_t line = (t_y % 8) * 2;
-            uint8_t b1 = mmu->read_byte(tile_data_addr + line);
-            uint8_t b2 = mmu->read_byte(tile_data_addr + line + 1);
+            // Handle horizontal flip (Bit 5)
+            const uint8_t* pixels = (attributes & 0x20) ? tile_cache.get_flipped_row(tile, line) : tile_cache.get_row(tile, line);
 
-            int bit = 7 - (t_x % 8);
-            uint8_t color_id = ((b2 >> bit) & 0x01) << 1 | ((b1 >> bit) & 0x01);
+            for (int x = 0; x < 8; x++) {
+                int pixel_x = sprite_x + x;
+                if (pixel_x < 0 || pixel_x >= 160) continue;
 
-            bg_color_ids[px] = color_id;
+                uint8_t color_id = pixels[x];
 
-            // Apply palette and write to framebuffer
-            uint8_t palette_color = (bgp >> (color_id * 2)) & 0x03;
-            framebuffer[ly * 160 + px] = shades[palette_color];
+                // Sprites come in priority order, so the first opaque pixel wins - even if it is then hidden behind
+                // the background, which is up to the compositor (OBJ-to-BG priority, OAM bit 7)
+                if (color_id != 0 && layers.obj[pixel_x] == 0) {
+                    layers.obj[pixel_x] = palette + color_id;
+                    layers.obj_front[pixel_x] = behind_bg ? 0 : palette + color_id;
+                }
+            }
         }
+    }
 
-        if (window_drawn) {
-            window_line_counter++;
+    compositor.compose(layers, bgp, mmu->get_io(0x48), mmu->get_io(0x49), framebuffer + ly * 160);
+}
+
+void PPU::build_sprite_buckets(uint8_t sprite_height) {
+    const uint8_t* oam = mmu->get_oam();
+    memset(sprite_counts, 0, sizeof(sprite_counts));
+
+    for (uint8_t index = 0; index < 40; index++) {
+        int top = oam[index * 4] - 16;
+        uint8_t x = oam[index * 4 + 1];
+
+        for (int ly = std::max(top, 0); ly < std::min(top + sprite_height, 144); ly++) {
+            // The OAM scan takes the first 10 sprites on a line in OAM order, wherever they are horizontally
+            uint8_t& count = sprite_counts[ly];
+            if (count == 10) continue;
+
+            // Keep the line sorted by priority - lower X first, then lower OAM index, which comes first anyway
+            uint8_t* sprites = line_sprites[ly];
+            int position = count;
+            while (position > 0 && oam[sprites[position - 1] * 4 + 1] > x) {
+                sprites[position] = sprites[position - 1];
+                position--;
+            }
+            sprites[position] = index;
+            count++;
         }
     }
 
-    // Draw sprite(s) (10 max per line) on top of background
-    if (lcdc & 0x02) {
-        int sprites_on_line = 0;
-        uint8_t used_sprite_x_coords[160] = {};
-        for (int i = 0; i < 40; i++) {
-            uint16_t oam_addr = 0xFE00 + (i * 4);
-            if (sprites_on_line >= 10) break;
-            
-            // Get proper sprite attributes
-            uint8_t sprite_y = mmu->read_byte(oam_addr) - 16;
-            uint8_t sprite_x = mmu->read_byte(oam_addr + 1) - 8;
-            uint8_t tile_index = mmu->read_byte(oam_addr + 2);
-            uint8_t attributes = mmu->read_byte(oam_addr + 3);
-            uint8_t sprite_height = (lcdc & 0x04) ? 16 : 8;
-
-            // Check if sprite is visible on this scanline (ly)
-            if (ly >= sprite_y && ly < sprite_y + sprite_height) {
-                sprites_on_line++;
-
-                // Check if sprite at this X coordinate has already been used (priority)
-                if (sprite_x >= 0 && sprite_x < 160) {
-                    if (used_sprite_x_coords[sprite_x]) {
-                        continue;
-                    } else {
-                        used_sprite_x_coords[sprite_x] = 1;
-                    }
-                }
-
-                // Determine which palette to use (Bit 4: 0=OBP0, 1=OBP1)
-                uint8_t obp = mmu->read_byte((attributes & 0x10) ? 0xFF49 : 0xFF48);
-                
-                // Fetch tile data (Sprites always use 0x8000-0x8FFF unsigned mode)
-                uint16_t tile_addr;
-                uint8_t line = (ly - sprite_y);
-
-                // Handle vertical flip (Bit 6)
-                if (attributes & 0x40) line = (sprite_height - 1) - line;
-
-                if (sprite_height == 16) {
-                    // For 8x16 sprites, bit 0 of the tile index is ignored for the base
-                    uint8_t base_tile = tile_index & 0xFE;
-                    uint8_t actual_tile = (line < 8) ? base_tile : (base_tile | 0x01);
-                    
-                    tile_addr = 0x8000 + (actual_tile * 16);
-                    // Reset line to 0-7 for the specific 8x8 tile selected
-                    line %= 8;
-                } else {
-                    // Standard 8x8 mode
-                    tile_addr = 0x8000 + (tile_index * 16);
-                }
+    bucket_height = sprite_height;
+    mmu->get_video_dirty().clear_sprites();
+}
 
-                uint8_t b1 = mmu->read_byte(tile_addr + (line * 2));
-                uint8_t b2 = mmu->read_byte(tile_addr + (line * 2) + 1);
+void PPU::draw_tiles(uint8_t* color_ids, int start, int end, uint16_t map_offset, uint8_t x, uint8_t y, bool unsigned_data) {
+    const uint8_t* map_row = mmu->get_vram() + map_offset + (y / 8) * 32;
+    uint8_t row = y % 8;
 
-                for (int x = 0; x < 8; x++) {
-                    int pixel_x = sprite_x + x;
-                    if (pixel_x < 0 || pixel_x >= 160) continue;
+    // One tile row at a time - only the first and last tile can be cut off
+    int px = start;
+    while (px < end) {
+        uint8_t tile_index = map_row[x / 8];
 
-                    // Handle horizontal flip (Bit 5)
-                    int bit = (attributes & 0x20) ? x : 7 - x;
-                    uint8_t color_id = ((b2 >> bit) & 0x01) << 1 | ((b1 >> bit) & 0x01);
+        // Signed addressing puts tiles 0-127 at $9000 and 128-255 at $8800
+        int tile = unsigned_data ? tile_index : 256 + static_cast<int8_t>(tile_index);
 
-                    // Don't draw transparent pixels (color 0)
-                    if (color_id != 0) {
-                        // OBJ-to-BG priority (OAM bit 7)
-                        uint8_t bg_id = bg_color_ids[pixel_x];
-                        bool bg_over_obj = (attributes & 0x80) != 0;
+        int column = x % 8;
+        int count = std::min(8 - column, end - px);
+        memcpy(color_ids + px, tile_cache.get_row(tile, row) + column, count);
 
-                        if (!bg_over_obj || (bg_over_obj && bg_id == 0)) {
-                            uint8_t palette_color = (obp >> (color_id * 2)) & 0x03;
-                            framebuffer[ly * 160 + pixel_x] = shades[palette_color];
-                        }
-                    }
-                }
-            }
-        }
+        px += count;
+        x += count;
     }
 }
 
 void PPU::request_interrupt(uint8_t bit) {
-    uint8_t if_reg = mmu->read_byte(0xFF0F);
-    if_reg |= (1 << bit);
-    mmu->write_byte(0xFF0F, if_reg);
+    interrupts->request(static_cast<InterruptController::Interrupt>(bit));
 }
\ No newline at end of file
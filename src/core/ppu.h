@@ -1,6 +1,9 @@
 #pragma once
 #include "mmu.h"
-#include <SDL3/SDL.h>
+#include "scheduler.h"
+#include "interrupts.h"
+#include "tile_cache.h"
+#include "compositor.h"
 
 class PPU {
     public:
@@ -8,20 +11,50 @@ class PPU {
 
         MMU* mmu = nullptr;
 
-        // Connect instance of MMU to read VRAM
+        // Connect instance of MMU to read VRAM, and take over the LCD registers ($FF40-$FF45, $FF47)
         void connect_mmu(MMU* m);
 
-        // Initalize SDL3 components
-        void init_sdl();
+        // V-blank and STAT interrupts are requested here
+        InterruptController* interrupts = nullptr;
+        void connect_interrupts(InterruptController* i);
 
-        // Render frame from framebuffer
-        void render_frame();
+        // Master clock the PPU is kept in step with (without one, only tick() moves it)
+        Scheduler* scheduler = nullptr;
+        void connect_scheduler(Scheduler* s);
 
-        // Render a blank (white) frame (used when LCD is disabled)
-        void render_blank();
+        // Tick the PPU up to the scheduler's clock and schedule its next event
+        void sync();
+
+        // Sync again once the current instruction is done
+        void schedule_sync();
+
+        // Turns each line's color indices into pixels - the fastest path the host supports unless set otherwise
+        ScanlineCompositor& get_compositor() { return compositor; }
+
+        // Shades (0 = white to 3 = black) of the last drawn frame (160x144 pixels) - ScanlineCompositor::expand()
+        // turns them into pixels of any palette
+        const uint8_t* get_framebuffer() const { return framebuffer; }
+
+        // Draw every Nth frame, 0 for none - skipped frames keep every mode, STAT, LY/LYC and interrupt timing and
+        // just leave the framebuffer alone (default: 1, every frame)
+        void set_render_interval(uint32_t interval) { render_interval = interval; }
+        uint32_t get_render_interval() const { return render_interval; }
+
+        // Draw the next frame whatever the interval - is_frame_rendered() is false until it's done
+        void request_frame() { render_requested = true; frame_rendered = false; }
+
+        // Leave the next frame undrawn unless one is requested (frame-skip for a frontend that's fallen behind)
+        void skip_frame() { skip_requested = true; }
+
+        // Whether the framebuffer holds the last frame that reached V-blank - false after a skipped one
+        bool is_frame_rendered() const { return frame_rendered; }
 
         // Tick PPU with given CPU cycles
-        void tick(uint8_t cycles);
+        void tick(uint32_t cycles);
+
+        // Cycles until the next mode or LY change - the only points where the PPU raises interrupts or changes
+        // LY/STAT. Returns UINT32_MAX while the LCD is off
+        uint32_t cycles_until_event() const;
 
         // Get/reset internal scanline values
         uint8_t get_ly() const { return current_ly; }
@@ -46,15 +79,10 @@ class PPU {
         uint8_t get_bgp() const { return bgp; }
         void set_bgp(uint8_t value) { bgp = value; }
     private:
-        // SDL components
-        SDL_Window* window = nullptr;
-        SDL_Renderer* renderer = nullptr;
-        SDL_Texture* texture = nullptr;
-
         // Basic PPU functions
 
-        // Raw pixel data (160x144 pixels)
-        uint32_t framebuffer[160 * 144];
+        // One shade per pixel (160x144 pixels)
+        uint8_t framebuffer[160 * 144];
 
         // General hardware registers
         uint8_t lcdc, stat, scy, scx, lyc, bgp;
@@ -65,6 +93,9 @@ class PPU {
         // Cycle count for PPU timing
         uint16_t ppu_cycles;
 
+        // Scheduler cycle the PPU has been ticked up to
+        uint64_t synced_cycle = 0;
+
         // Initial mode on startup is OAM search
         uint8_t mode = 2;
 
@@ -77,9 +108,46 @@ class PPU {
         // Flag to indicate if PPU is rendering first frame after LCD enable
         bool first_frame_after_enable = false;
 
+        // Whether the frame in progress is drawn, and what decides the next one
+        bool drawing_frame = true;
+        bool frame_rendered = false;
+        bool render_requested = false;
+        bool skip_requested = false;
+        uint32_t render_interval = 1;
+        uint32_t frames_skipped = 0;
+
+        // Decide whether the frame starting now is drawn
+        void begin_frame();
+
+        // Decoded VRAM tiles, caught up at the start of every scanline
+        TileCache tile_cache;
+
+        // Line being drawn, and what composes it
+        ScanlineCompositor::Layers layers;
+        ScanlineCompositor compositor;
+
+        // OAM indices of the sprites on each line, highest priority first - rebuilt when OAM or the sprite height
+        // changes, so a line only looks at its own sprites
+        uint8_t line_sprites[144][10];
+        uint8_t sprite_counts[144] = {};
+        uint8_t bucket_height = 0;
+
+        void build_sprite_buckets(uint8_t sprite_height);
+
         // Read VRAM and fill frame buffer
         void draw_scanline();
 
+        // Keep the window line counter where draw_scanline() would leave it, without drawing
+        void skip_scanline();
+
+        // Color indices of the tile map at map_offset (into VRAM) for pixels start..end-1 of a line, starting at map
+        // position (x, y) - x wraps around the 256-pixel map
+        void draw_tiles(uint8_t* color_ids, int start, int end, uint16_t map_offset, uint8_t x, uint8_t y, bool unsigned_data);
+
+        // CPU accesses to the LCD registers ($FF00 + reg)
+        uint8_t read_register(uint8_t reg);
+        void write_register(uint8_t reg, uint8_t value);
+
         // Request interrupt
         void request_interrupt(uint8_t bit);
 };
\ No newline at end of file
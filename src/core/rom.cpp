@@ -1,62 +1,147 @@
 #include "rom.h"
 #include <cstdio>
 #include <string>
-const unsigned char* ROM::data = nullptr;
-size_t ROM::size = 0;
+#include <map>
+#include <mutex>
 
-void ROM::unload() {
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Every ROM that is currently open, by path - entries expire with the last handle to their ROM
+    std::mutex registry_mutex;
+    std::map<std::string, std::weak_ptr<const ROM>> registry;
+}
+
+std::shared_ptr<const ROM> ROM::open(const char* filename) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    // Already open - share the mapping
+    auto entry = registry.find(filename);
+    if (entry != registry.end()) {
+        if (std::shared_ptr<const ROM> rom = entry->second.lock()) {
+            return rom;
+        }
+    }
+
+    std::shared_ptr<ROM> rom(new ROM());
+    if (!rom->map(filename)) {
+        return nullptr;
+    }
+
+    // Whether the cartridge type is supported is up to MBC::create() - only reject files without a full header
+    if (rom->size <= OFFSET_RAM_SIZE) {
+        printf("[ROM] File is too small to be a ROM: %zu bytes\n", rom->size);
+        return nullptr;
+    }
+
+    rom->path = filename;
+    registry[rom->path] = rom;
+
+    // Debug - log ROM's header values
+    printf("[ROM] Successfully loaded ROM: %s\n", filename);
+    std::string title(reinterpret_cast<const char*>(rom->data + OFFSET_TITLE), 16);
+    printf("[ROM] ROM title: %s\n", title.c_str());
+    printf("[ROM] ROM size: %zu bytes\n", rom->size);
+    printf("[ROM] ROM type: 0x%02X\n", rom->data[OFFSET_TYPE]);
+    printf("[ROM] ROM size byte: 0x%02X\n", rom->data[OFFSET_ROM_SIZE]);
+    printf("[ROM] RAM size byte: 0x%02X\n", rom->data[OFFSET_RAM_SIZE]);
+
+    return rom;
+}
+
+#ifdef _WIN32
+bool ROM::map(const char* filename) {
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping keeps the file open on its own
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(file_size.QuadPart);
+    mapping_handle = mapping;
+    return true;
+}
+
+ROM::~ROM() {
     if (data) {
-        delete[] data;
-        data = nullptr;
-        size = 0;
+        UnmapViewOfFile(data);
+        CloseHandle(mapping_handle);
     }
 }
+#else
+bool ROM::map(const char* filename) {
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
 
-bool ROM::load(const char* filename) {
-    unload(); // Unload any existing ROM
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
 
-    // Open file
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
+    // The mapping keeps the file open on its own
+    void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
         return false;
     }
 
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(info.st_size);
+    return true;
+}
 
-    // Allocate memory and read file
-    data = new unsigned char[size];
-    fread((void*)data, 1, size, file);
-    fclose(file);
+ROM::~ROM() {
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+}
+#endif
 
-    // Only allow supported ROM types
-    switch (data[OFFSET_TYPE]) {
-        case ROM_PLAIN:
-            break;
-        case ROM_MBC1:
-        case ROM_MBC1_RAM:
+bool ROM::has_battery(unsigned char type) {
+    switch (type) {
         case ROM_MBC1_RAM_BATT:
-            break;
+        case ROM_MBC2_BATTERY:
+        case ROM_RAM_BATTERY:
+        case ROM_MMM01_SRAM_BATT:
+        case ROM_MBC3_TIMER_BATT:
+        case ROM_MBC3_TIMER_RAM_BATT:
+        case ROM_MBC3_RAM_BATT:
+        case ROM_MBC5_RAM_BATT:
+        case ROM_MBC5_RUMBLE_SRAM_BATT:
+        case ROM_HUDSON_HUC1:
+            return true;
         default:
-            printf("[ROM] Unsupported or unimplemented ROM type: 0x%02X\n", data[OFFSET_TYPE]);
-            unload();
             return false;
-            break;
     }
-
-    // Debug - log ROM's header values
-    printf("[ROM] Successfully loaded ROM: %s\n", filename);
-    std::string title(reinterpret_cast<const char*>(data + OFFSET_TITLE), 16);
-    printf("[ROM] ROM title: %s\n", title.c_str());
-    printf("[ROM] ROM size: %zu bytes\n", size);
-    unsigned char rom_type = data[OFFSET_TYPE];
-    printf("[ROM] ROM type: 0x%02X\n", rom_type);
-    unsigned char rom_size = data[OFFSET_ROM_SIZE];
-    printf("[ROM] ROM size byte: 0x%02X\n", rom_size);
-    unsigned char ram_size = data[OFFSET_RAM_SIZE];
-    printf("[ROM] RAM size byte: 0x%02X\n", ram_size);
-
-    return true;
-}
\ No newline at end of file
+}
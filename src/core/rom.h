@@ -1,13 +1,36 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
 
+/**
+ * @brief A cartridge ROM image, mapped read-only from its file.
+ *
+ * ROMs are only handed out through ROM::open() as shared handles. Opening a file that is already open returns the
+ * existing mapping, so any number of emulator instances running the same game share a single copy of it, and nothing
+ * is read up front - the OS pages the file in as it is accessed. The mapping goes away with the last handle.
+ */
 class ROM {
     public:
-        static bool load(const char* filename);
-        static void unload();
+        ~ROM();
 
-        static const unsigned char* data;
-        static size_t size;
+        ROM(const ROM&) = delete;
+        ROM& operator=(const ROM&) = delete;
+
+        // Map a ROM file, or share its mapping if it is already open
+        // Returns nullptr if the file can't be opened or is too small to hold a cartridge header
+        static std::shared_ptr<const ROM> open(const char* filename);
+
+        const uint8_t* get_data() const { return data; }
+        size_t get_size() const { return size; }
+        const std::string& get_path() const { return path; }
+
+        // Cartridge type from the header (see romType)
+        uint8_t get_type() const { return data[OFFSET_TYPE]; }
+
+        // True for cartridge types with battery-backed RAM (or clock) that should be saved
+        static bool has_battery(unsigned char type);
 
         enum romOffsets {
             OFFSET_TITLE = 0x0134,
@@ -43,4 +66,17 @@ class ROM {
             ROM_HUDSON_HUC3 = 0xFE,
             ROM_HUDSON_HUC1 = 0xFF,
         };
+    private:
+        ROM() = default;
+
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        std::string path;
+
+#ifdef _WIN32
+        void* mapping_handle = nullptr;
+#endif
+
+        // Map the file read-only, returns false if it can't be opened
+        bool map(const char* filename);
 };
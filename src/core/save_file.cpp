@@ -0,0 +1,150 @@
+#include "save_file.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<SaveFile> SaveFile::open(const char* filename, size_t size, bool& created) {
+    std::unique_ptr<SaveFile> save(new SaveFile());
+    if (!save->map(filename, size, created)) {
+        printf("[SaveFile] Failed to map save file: %s\n", filename);
+        return nullptr;
+    }
+
+    save->flush_thread = std::thread(&SaveFile::flush_loop, save.get());
+    return save;
+}
+
+SaveFile::~SaveFile() {
+    if (flush_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex);
+            closing = true;
+        }
+        flush_signal.notify_one();
+        flush_thread.join();
+    }
+
+    if (!data) return;
+
+    flush();
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+#else
+    munmap(data, size);
+#endif
+}
+
+void SaveFile::request_flush() {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        flush_requested = true;
+    }
+    flush_signal.notify_one();
+}
+
+void SaveFile::flush_loop() {
+    std::unique_lock<std::mutex> lock(flush_mutex);
+
+    while (true) {
+        flush_signal.wait(lock, [this] { return flush_requested || closing; });
+        if (closing) return;
+
+        // Requests made while this flush runs are picked up by the next one
+        flush_requested = false;
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+#ifdef _WIN32
+bool SaveFile::map(const char* filename, size_t size, bool& created) {
+    HANDLE file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    created = (file_size.QuadPart == 0);
+
+    // Grow short (or new) files - longer ones, e.g. saves with appended clock data, are left as they are
+    LARGE_INTEGER mapping_size;
+    mapping_size.QuadPart = (file_size.QuadPart > static_cast<LONGLONG>(size)) ? file_size.QuadPart : size;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, mapping_size.HighPart, mapping_size.LowPart, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    data = static_cast<uint8_t*>(view);
+    this->size = size;
+    file_handle = file;
+    mapping_handle = mapping;
+    return true;
+}
+
+void SaveFile::flush() {
+    FlushViewOfFile(data, size);
+    FlushFileBuffers(file_handle);
+}
+#else
+bool SaveFile::map(const char* filename, size_t size, bool& created) {
+    int fd = ::open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    created = (info.st_size == 0);
+
+    // Grow short (or new) files - longer ones, e.g. saves with appended clock data, are left as they are
+    if (static_cast<size_t>(info.st_size) < size && ftruncate(fd, size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file open on its own
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    data = static_cast<uint8_t*>(view);
+    this->size = size;
+    return true;
+}
+
+void SaveFile::flush() {
+    msync(data, size, MS_SYNC);
+}
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @brief Battery-backed cartridge RAM, memory-mapped from its .sav file.
+ *
+ * The mapping is shared with the file, so every write the game makes lands in the OS page cache immediately and
+ * survives the emulator crashing or being killed - nothing has to be saved on exit. The OS only tracks which pages
+ * are dirty, though, so request_flush() asks a background thread to write them back to disk, keeping the (bounded,
+ * dirty pages only) I/O off the emulation thread. The last flush happens synchronously when the file is closed.
+ */
+class SaveFile {
+    public:
+        ~SaveFile();
+
+        SaveFile(const SaveFile&) = delete;
+        SaveFile& operator=(const SaveFile&) = delete;
+
+        // Map a save file, creating it (or growing it) to at least size bytes
+        // created is set if there was no save data yet. Returns nullptr if the file can't be opened or mapped
+        static std::unique_ptr<SaveFile> open(const char* filename, size_t size, bool& created);
+
+        uint8_t* get_data() const { return data; }
+        size_t get_size() const { return size; }
+
+        // Have the flush thread write dirty pages back to disk - returns immediately
+        void request_flush();
+    private:
+        SaveFile() = default;
+
+        uint8_t* data = nullptr;
+        size_t size = 0;
+
+#ifdef _WIN32
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+
+        std::thread flush_thread;
+        std::mutex flush_mutex;
+        std::condition_variable flush_signal;
+        bool flush_requested = false;
+        bool closing = false;
+
+        bool map(const char* filename, size_t size, bool& created);
+
+        // Write dirty pages back and wait for them to reach the disk
+        void flush();
+
+        void flush_loop();
+};
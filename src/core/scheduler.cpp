@@ -0,0 +1,44 @@
+#include "scheduler.h"
+
+void Scheduler::schedule(Event event, uint64_t deadline) {
+    cancel(event);
+
+    // Insert after every event due at or before the new deadline
+    size_t position = count;
+    while (position > 0 && queue[position - 1].cycle > deadline) {
+        queue[position] = queue[position - 1];
+        position--;
+    }
+
+    queue[position] = { deadline, event };
+    count++;
+    update_deadline();
+}
+
+void Scheduler::cancel(Event event) {
+    for (size_t i = 0; i < count; i++) {
+        if (queue[i].event == event) {
+            for (size_t j = i + 1; j < count; j++) {
+                queue[j - 1] = queue[j];
+            }
+            count--;
+            update_deadline();
+            return;
+        }
+    }
+}
+
+bool Scheduler::pop_due(Event& event) {
+    if (count == 0 || queue[0].cycle > cycle) {
+        return false;
+    }
+
+    event = queue[0].event;
+    for (size_t i = 1; i < count; i++) {
+        queue[i - 1] = queue[i];
+    }
+    count--;
+    update_deadline();
+
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Master cycle clock and queue of upcoming hardware events.
+ *
+ * Instead of ticking every component after every instruction, each component registers the cycle at which it next
+ * needs attention (the PPU's next mode change, the next TIMA overflow, a queued joypad input, ...). The CPU then
+ * runs with a single clock comparison per instruction, and GameBoy::step() only brings a component up to date once
+ * its deadline has passed. Components that are read or written in between (timer and PPU registers) catch up on
+ * demand at that access.
+ *
+ * The clock counts CPU cycles (4.194304 MHz) since power-on. The CPU moves it forward after every instruction - one
+ * at a time, inside cached and compiled blocks too - so get_cycle() during an instruction is the cycle at which that
+ * instruction started. A block stops at the instruction after which an event comes due, so events (and the
+ * interrupts they raise) are handled at exactly the same point as when stepping one instruction at a time.
+ *
+ * Each event can be pending at most once - scheduling it again moves its deadline. With only a handful of event
+ * kinds the queue is a small array kept sorted by deadline.
+ */
+class Scheduler {
+    public:
+        // New subsystems (serial, APU, ...) add their event here and handle it in GameBoy::run_events()
+        enum Event : uint8_t {
+            EVENT_PPU,      // PPU mode or LY change
+            EVENT_TIMER,    // TIMA overflow, or the end of a pending TMA reload
+            EVENT_JOYPAD,   // Queued joypad input
+            EVENT_DMA,      // End of an OAM DMA transfer
+            EVENT_SAVE,     // Periodic battery save flush
+            EVENT_COUNT
+        };
+
+        static const uint64_t NEVER = UINT64_MAX;
+
+        // Current master clock
+        uint64_t get_cycle() const { return cycle; }
+
+        // Earliest pending deadline, NEVER if the queue is empty
+        uint64_t get_next_deadline() const { return next_deadline; }
+
+        // Whether an event has come due
+        bool is_due() const { return cycle >= next_deadline; }
+
+        // Move the clock forward - returns true if an event has come due
+        bool advance(uint32_t cycles) {
+            cycle += cycles;
+            return cycle >= next_deadline;
+        }
+
+        // Schedule (or reschedule) an event for an absolute cycle
+        void schedule(Event event, uint64_t deadline);
+
+        // Remove an event from the queue if it is pending
+        void cancel(Event event);
+
+        // Take the earliest event that has come due, returns false once there are none left
+        bool pop_due(Event& event);
+    private:
+        struct Entry {
+            uint64_t cycle;
+            Event event;
+        };
+
+        uint64_t cycle = 0;
+
+        // Deadline of queue[0], kept next to the clock - compiled blocks compare the two after every instruction
+        uint64_t next_deadline = NEVER;
+
+        // Pending events, sorted by deadline (ties keep the order they were scheduled in)
+        Entry queue[EVENT_COUNT];
+        size_t count = 0;
+
+        void update_deadline() { next_deadline = count > 0 ? queue[0].cycle : NEVER; }
+
+        friend class JIT;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include "video_dirty.h"
+
+/**
+ * @brief Every VRAM tile, decoded into rows of 2-bit color indices.
+ *
+ * A tile row is stored in VRAM as two bitplane bytes, so reading one pixel means fetching both and picking a bit out
+ * of each. The cache keeps all 384 tiles ($8000-$97FF) decoded into 8x8 bytes - plus a horizontally flipped copy for
+ * sprites - so the PPU can copy whole rows out of it instead. Tiles are only decoded again once VideoDirtyTracker says a
+ * write changed them.
+ */
+class TileCache {
+    public:
+        static const int TILE_COUNT = VideoDirtyTracker::TILE_COUNT;
+
+        // Decode the tiles changed since the last update, and clear their dirty bits
+        void update(const uint8_t* vram, VideoDirtyTracker& dirty) {
+            if (!dirty.any_tile_dirty()) return;
+
+            for (int tile = dirty.find_dirty_tile(0); tile < TILE_COUNT; tile = dirty.find_dirty_tile(tile + 1)) {
+                decode(vram + tile * 16, tile);
+                dirty.clear_tile(tile);
+            }
+        }
+
+        // 8 color indices (0-3) of a tile row, leftmost pixel first - tiles are numbered by VRAM offset / 16
+        const uint8_t* get_row(int tile, int row) const { return pixels[tile][row]; }
+
+        // The same row mirrored, for sprites with the X flip attribute
+        const uint8_t* get_flipped_row(int tile, int row) const { return flipped[tile][row]; }
+    private:
+        uint8_t pixels[TILE_COUNT][8][8];
+        uint8_t flipped[TILE_COUNT][8][8];
+
+        void decode(const uint8_t* data, int tile) {
+            for (int row = 0; row < 8; row++) {
+                uint8_t low = data[row * 2];
+                uint8_t high = data[row * 2 + 1];
+
+                for (int x = 0; x < 8; x++) {
+                    int bit = 7 - x;
+                    uint8_t color_id = ((high >> bit) & 0x01) << 1 | ((low >> bit) & 0x01);
+                    pixels[tile][row][x] = color_id;
+                    flipped[tile][row][7 - x] = color_id;
+                }
+            }
+        }
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Records which parts of VRAM and OAM have changed, so video consumers only redo work for what did.
+ *
+ * VRAM is tracked per 16-byte tile in the tile data area ($8000-$97FF, tiles 0-383 by offset / 16) and per 32-byte
+ * row in the two tile maps ($9800-$9BFF and $9C00-$9FFF), OAM per 4-byte sprite entry. The MMU marks them on every
+ * write that changes a byte. A consumer checks the bits it cares about and clears them once it has caught up - the
+ * generation counter goes up with every change, so a consumer that only needs to know whether anything changed at
+ * all (e.g. a debugger view) can compare it with the value it last saw instead of clearing bits others rely on.
+ *
+ * Everything starts out dirty, since nobody has seen the initial contents.
+ */
+class VideoDirtyTracker {
+    public:
+        static const int TILE_COUNT = 384;
+        static const int MAP_COUNT = 2;
+        static const int MAP_ROWS = 32;
+        static const int SPRITE_COUNT = 40;
+
+        VideoDirtyTracker() { mark_all(); }
+
+        // Note a changed byte, by offset into VRAM ($8000 + offset) or OAM ($FE00 + offset)
+        void mark_vram(uint16_t offset) {
+            if (offset < TILE_DATA_SIZE) {
+                set_bit(tiles, offset >> 4);
+            } else {
+                map_rows |= 1ull << ((offset - TILE_DATA_SIZE) >> 5);
+            }
+            generation++;
+        }
+        void mark_oam(uint8_t offset) {
+            sprites |= 1ull << (offset >> 2);
+            generation++;
+        }
+
+        // Everything changed at once (e.g. the machine was reset)
+        void mark_all() {
+            for (uint64_t& word : tiles) word = ~0ull;
+            map_rows = ~0ull;
+            sprites = (1ull << SPRITE_COUNT) - 1;
+            generation++;
+        }
+
+        // Goes up with every change
+        uint64_t get_generation() const { return generation; }
+
+        bool is_tile_dirty(int tile) const { return (tiles[tile >> 6] >> (tile & 63)) & 1; }
+        bool is_map_row_dirty(int map, int row) const { return (map_rows >> (map * MAP_ROWS + row)) & 1; }
+        bool is_sprite_dirty(int sprite) const { return (sprites >> sprite) & 1; }
+
+        bool any_tile_dirty() const {
+            for (uint64_t word : tiles) {
+                if (word) return true;
+            }
+            return false;
+        }
+        bool any_map_row_dirty() const { return map_rows != 0; }
+        bool any_sprite_dirty() const { return sprites != 0; }
+
+        // First dirty tile at or after start, TILE_COUNT if there is none - for walking the dirty tiles in order
+        int find_dirty_tile(int start) const {
+            for (int tile = start; tile < TILE_COUNT; tile++) {
+                uint64_t word = tiles[tile >> 6] >> (tile & 63);
+                if (!word) {
+                    // Nothing left in this word, go to the next one
+                    tile |= 63;
+                    continue;
+                }
+                if (word & 1) return tile;
+            }
+            return TILE_COUNT;
+        }
+
+        void clear_tile(int tile) { tiles[tile >> 6] &= ~(1ull << (tile & 63)); }
+        void clear_map_row(int map, int row) { map_rows &= ~(1ull << (map * MAP_ROWS + row)); }
+        void clear_sprite(int sprite) { sprites &= ~(1ull << sprite); }
+
+        void clear_tiles() { for (uint64_t& word : tiles) word = 0; }
+        void clear_map_rows() { map_rows = 0; }
+        void clear_sprites() { sprites = 0; }
+        void clear() { clear_tiles(); clear_map_rows(); clear_sprites(); }
+    private:
+        static const uint16_t TILE_DATA_SIZE = 0x1800;
+
+        // One bit per tile, tile map row (map 0 rows in bits 0-31, map 1 in bits 32-63) and sprite
+        uint64_t tiles[TILE_COUNT / 64];
+        uint64_t map_rows;
+        uint64_t sprites;
+
+        uint64_t generation = 0;
+
+        static void set_bit(uint64_t* words, int bit) { words[bit >> 6] |= 1ull << (bit & 63); }
+};
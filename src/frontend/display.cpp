@@ -0,0 +1,36 @@
+#include "display.h"
+
+bool Display::init() {
+    // Initialize the window. Render at 2x scale for visibility
+    window = SDL_CreateWindow("GameByte", (160*2), (144*2), 0);
+    if (!window) return false;
+
+    renderer = SDL_CreateRenderer(window, nullptr);
+    if (!renderer) return false;
+
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 160, 144);
+    if (!texture) return false;
+
+    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+    return true;
+}
+
+void Display::render_frame(const uint8_t* shades) {
+    converter.expand(shades, 160 * 144, palette, pixels);
+    SDL_UpdateTexture(texture, NULL, pixels, 160 * sizeof(uint32_t));
+    SDL_RenderClear(renderer);
+    SDL_RenderTexture(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+}
+
+void Display::set_palette(const uint32_t colors[4]) {
+    for (int i = 0; i < 4; i++) {
+        palette[i] = colors[i];
+    }
+}
+
+void Display::render_blank() {
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderClear(renderer);
+    SDL_RenderPresent(renderer);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <SDL3/SDL.h>
+#include "core/compositor.h"
+
+/**
+ * @brief SDL3 window that presents the PPU's framebuffer.
+ */
+class Display {
+    public:
+        // Initalize SDL3 components
+        bool init();
+
+        // Render frame from the PPU's 160x144 shades, in the current palette
+        void render_frame(const uint8_t* shades);
+
+        // ARGB8888 colors of shades 0-3 - grayscale until set
+        void set_palette(const uint32_t colors[4]);
+
+        // Render a blank (white) frame (used when LCD is disabled)
+        void render_blank();
+    private:
+        // SDL components
+        SDL_Window* window = nullptr;
+        SDL_Renderer* renderer = nullptr;
+        SDL_Texture* texture = nullptr;
+
+        // Expands shades into pixels once per presented frame
+        ScanlineCompositor converter;
+        uint32_t palette[4] = { ScanlineCompositor::PALETTE_GRAYSCALE[0], ScanlineCompositor::PALETTE_GRAYSCALE[1],
+                                ScanlineCompositor::PALETTE_GRAYSCALE[2], ScanlineCompositor::PALETTE_GRAYSCALE[3] };
+        uint32_t pixels[160 * 144];
+};
@@ -0,0 +1,27 @@
+#include "input.h"
+
+bool handle_sdl_input_event(GameBoy& gb, const SDL_Event& e) {
+    if (e.type != SDL_EVENT_KEY_DOWN && e.type != SDL_EVENT_KEY_UP) return false;
+
+    bool pressed = (e.type == SDL_EVENT_KEY_DOWN);
+    Joypad::Button button;
+
+    switch (e.key.key) {
+        // Directions
+        case SDLK_RIGHT:  button = Joypad::BUTTON_RIGHT;  break;
+        case SDLK_LEFT:   button = Joypad::BUTTON_LEFT;   break;
+        case SDLK_UP:     button = Joypad::BUTTON_UP;     break;
+        case SDLK_DOWN:   button = Joypad::BUTTON_DOWN;   break;
+
+        // Actions
+        case SDLK_Z:      button = Joypad::BUTTON_A;      break;
+        case SDLK_X:      button = Joypad::BUTTON_B;      break;
+        case SDLK_RSHIFT: button = Joypad::BUTTON_SELECT; break;
+        case SDLK_RETURN: button = Joypad::BUTTON_START;  break;
+
+        default: return false;
+    }
+
+    gb.set_button(button, pressed);
+    return true;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include "core/gameboy.h"
+
+// Handles SDL keyboard events and forwards them to the emulated joypad
+// Returns true if the event was a mapped Game Boy button
+bool handle_sdl_input_event(GameBoy& gb, const SDL_Event& e);
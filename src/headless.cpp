@@ -0,0 +1,432 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/gameboy.h"
+
+// How long a --press holds its button - long enough for games that debounce input over a few frames
+static const uint64_t PRESS_FRAMES = 5;
+
+static void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " --rom <file.gb> [--frames N] [--unthrottled] [--bench-cpu] [--block-cache] [--jit] [--jit-lockstep] [--press BUTTON@FRAME]... [--watch|--break-on KINDS:RANGE]... [--on-fault halt|log|ignore] [--compositor scalar|sse2|avx2] [--verify-compositor] [--render-every N]" << std::endl;
+    std::cout << "  --rom <file.gb>  Game Boy ROM to run" << std::endl;
+    std::cout << "  --frames N       Number of frames to emulate (default: 600)" << std::endl;
+    std::cout << "  --unthrottled    Run as fast as the host allows instead of at 59.73 Hz" << std::endl;
+    std::cout << "  --bench-cpu      CPU throughput test - run only the CPU interpreter (no timers/PPU) and report MIPS" << std::endl;
+    std::cout << "  --block-cache    Execute pre-decoded basic blocks instead of single instructions" << std::endl;
+    std::cout << "  --jit            Compile hot blocks to x86-64 code (implies --block-cache)" << std::endl;
+    std::cout << "  --jit-lockstep   Like --jit, but check every step against an interpreted copy and stop at the first difference" << std::endl;
+    std::cout << "  --press B@F      Hold a button (a, b, select, start, right, left, up, down) for " << PRESS_FRAMES << " frames from frame F" << std::endl;
+    std::cout << "  --watch K:R      Log reads (r), writes (w) and/or instruction fetches (x) in a hex range, e.g. w:C000-C0FF or x:0150" << std::endl;
+    std::cout << "  --break-on K:R   Like --watch, but stop at the first hit and dump the recent instructions" << std::endl;
+    std::cout << "  --on-fault P     What to do when the ROM touches unusable memory or runs an illegal opcode: stop with an error (halt, default), print it and carry on (log), or carry on silently (ignore)" << std::endl;
+    std::cout << "  --compositor P   Scanline compositor to use instead of the fastest one the host supports" << std::endl;
+    std::cout << "  --verify-compositor  Run a second machine with the scalar compositor and stop at the first frame that differs" << std::endl;
+    std::cout << "  --render-every N Only draw every Nth frame, or none with 0 - timing and interrupts stay exact (default: 1)" << std::endl;
+}
+
+struct WatchSpec {
+    uint16_t start;
+    uint16_t end;
+    uint8_t kinds;
+    bool pause;
+};
+
+// Parse "<kinds>:<start>[-<end>]" for --watch/--break-on
+static bool parse_watch(const char* text, bool pause, WatchSpec& watch) {
+    const char* separator = strchr(text, ':');
+    if (!separator || separator == text) return false;
+
+    watch.kinds = 0;
+    for (const char* kind = text; kind < separator; kind++) {
+        switch (*kind) {
+            case 'r': watch.kinds |= MMU::WATCH_READ; break;
+            case 'w': watch.kinds |= MMU::WATCH_WRITE; break;
+            case 'x': watch.kinds |= MMU::WATCH_EXECUTE; break;
+            default: return false;
+        }
+    }
+
+    char* end = nullptr;
+    unsigned long start = std::strtoul(separator + 1, &end, 16);
+    if (end == separator + 1 || start > 0xFFFF) return false;
+
+    unsigned long last = start;
+    if (*end == '-') {
+        const char* range_end = end + 1;
+        last = std::strtoul(range_end, &end, 16);
+        if (end == range_end || last > 0xFFFF || last < start) return false;
+    }
+    if (*end != '\0') return false;
+
+    watch.start = static_cast<uint16_t>(start);
+    watch.end = static_cast<uint16_t>(last);
+    watch.pause = pause;
+    return true;
+}
+
+struct ScriptedPress {
+    Joypad::Button button;
+    uint64_t frame;
+};
+
+// Parse "<button>@<frame>" for --press
+static bool parse_press(const char* text, ScriptedPress& press) {
+    static const char* const NAMES[] = { "right", "left", "up", "down", "a", "b", "select", "start" };
+
+    const char* separator = strchr(text, '@');
+    if (!separator || separator[1] == '\0') return false;
+
+    std::string name(text, separator - text);
+    for (int i = 0; i < 8; i++) {
+        if (name == NAMES[i]) {
+            press.button = static_cast<Joypad::Button>(i);
+            press.frame = std::strtoull(separator + 1, nullptr, 10);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Queue the scripted presses on a machine - frames are counted as CYCLES_PER_FRAME steps of the master clock
+static void queue_presses(GameBoy& gb, const std::vector<ScriptedPress>& presses) {
+    for (const ScriptedPress& press : presses) {
+        gb.queue_button(press.button, true, press.frame * GameBoy::CYCLES_PER_FRAME);
+        gb.queue_button(press.button, false, (press.frame + PRESS_FRAMES) * GameBoy::CYCLES_PER_FRAME);
+    }
+}
+
+// Run a frame's worth of CPU::run(), the interpreter loop GameBoy::advance() uses, with the scheduler's events
+// dropped instead of handled so timers and the PPU stay frozen
+static uint32_t run_cpu_frame(GameBoy& gb) {
+    uint32_t cycles = 0;
+    Scheduler::Event event;
+
+    while (cycles < GameBoy::CYCLES_PER_FRAME && !gb.cpu.fault_halted) {
+        cycles += gb.cpu.run(GameBoy::CYCLES_PER_FRAME - cycles);
+        while (gb.scheduler.pop_due(event)) {}
+    }
+
+    return cycles;
+}
+
+static std::string describe_cpu(const CPU& cpu) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0')
+       << "PC=" << std::setw(4) << cpu.pc << " SP=" << std::setw(4) << cpu.sp
+       << " A=" << std::setw(2) << +cpu.a << " F=" << std::setw(2) << +cpu.get_f()
+       << " B=" << std::setw(2) << +cpu.b << " C=" << std::setw(2) << +cpu.c
+       << " D=" << std::setw(2) << +cpu.d << " E=" << std::setw(2) << +cpu.e
+       << " H=" << std::setw(2) << +cpu.h << " L=" << std::setw(2) << +cpu.l
+       << std::dec << " IME=" << cpu.ime << " HALT=" << cpu.halted
+       << " cycles=" << cpu.total_cycles << " instructions=" << cpu.total_instructions;
+    return ss.str();
+}
+
+static bool same_cpu_state(const CPU& x, const CPU& y) {
+    return x.pc == y.pc && x.sp == y.sp && x.a == y.a && x.get_f() == y.get_f() && x.b == y.b && x.c == y.c &&
+           x.d == y.d && x.e == y.e && x.h == y.h && x.l == y.l && x.ime == y.ime && x.halted == y.halted &&
+           x.total_cycles == y.total_cycles && x.total_instructions == y.total_instructions &&
+           x.fault_halted == y.fault_halted;
+}
+
+// Run a frame on the JIT machine and an interpreted reference machine side by side
+// Registers are compared after every step and RAM after the frame - throws on the first difference
+static uint32_t run_lockstep_frame(GameBoy& gb, GameBoy& reference) {
+    uint32_t cycles = 0;
+
+    while (cycles < GameBoy::CYCLES_PER_FRAME && !gb.is_fault_halted()) {
+        uint16_t pc = gb.cpu.pc;
+        uint8_t step_cycles = gb.step();
+        uint8_t reference_cycles = reference.step();
+
+        if (step_cycles != reference_cycles || !same_cpu_state(gb.cpu, reference.cpu)) {
+            std::stringstream ss;
+            ss << "[GameByte] JIT lockstep mismatch after the block at 0x" << std::hex << pc << std::dec
+               << " (" << +step_cycles << " vs " << +reference_cycles << " cycles)" << std::endl
+               << "  JIT:         " << describe_cpu(gb.cpu) << std::endl
+               << "  Interpreter: " << describe_cpu(reference.cpu);
+            throw std::runtime_error(ss.str());
+        }
+
+        cycles += step_cycles;
+    }
+
+    // VRAM, WRAM, OAM and HRAM/IE
+    static const uint16_t RANGES[][2] = { { 0x8000, 0x9FFF }, { 0xC000, 0xDFFF }, { 0xFE00, 0xFE9F }, { 0xFF80, 0xFFFF } };
+    for (const auto& range : RANGES) {
+        for (uint32_t address = range[0]; address <= range[1]; address++) {
+            uint8_t value = gb.mmu.read_byte(address);
+            uint8_t reference_value = reference.mmu.read_byte(address);
+
+            if (value != reference_value) {
+                std::stringstream ss;
+                ss << "[GameByte] JIT lockstep memory mismatch at 0x" << std::hex << address
+                   << ": " << +value << " vs " << +reference_value;
+                throw std::runtime_error(ss.str());
+            }
+        }
+    }
+
+    return cycles;
+}
+
+// Run a frame on two machines that only differ in their scanline compositor, and compare the framebuffers - both as
+// shades and expanded to pixels. Throws on the first pixel that differs
+static uint32_t run_compositor_frame(GameBoy& gb, GameBoy& reference, uint64_t frame) {
+    uint32_t cycles = gb.run_frame();
+    reference.run_frame();
+
+    const ScanlineCompositor& compositor = gb.ppu.get_compositor();
+    const ScanlineCompositor& reference_compositor = reference.ppu.get_compositor();
+
+    const uint8_t* shades = gb.ppu.get_framebuffer();
+    const uint8_t* reference_shades = reference.ppu.get_framebuffer();
+
+    static uint32_t pixels[160 * 144];
+    static uint32_t reference_pixels[160 * 144];
+    compositor.expand(shades, 160 * 144, ScanlineCompositor::PALETTE_DMG_GREEN, pixels);
+    reference_compositor.expand(reference_shades, 160 * 144, ScanlineCompositor::PALETTE_DMG_GREEN, reference_pixels);
+
+    for (int i = 0; i < 160 * 144; i++) {
+        if (shades[i] != reference_shades[i] || pixels[i] != reference_pixels[i]) {
+            bool expanded = shades[i] == reference_shades[i];
+
+            std::stringstream ss;
+            ss << "[GameByte] Compositor mismatch in frame " << frame << " at (" << (i % 160) << ", " << (i / 160) << "): "
+               << ScanlineCompositor::get_path_name(compositor.get_path()) << " "
+               << (expanded ? "pixel 0x" : "shade ") << std::hex
+               << (expanded ? pixels[i] : shades[i]) << " vs "
+               << ScanlineCompositor::get_path_name(reference_compositor.get_path()) << " "
+               << (expanded ? "0x" : "") << (expanded ? reference_pixels[i] : reference_shades[i]);
+            throw std::runtime_error(ss.str());
+        }
+    }
+
+    return cycles;
+}
+
+int main(int argc, char* argv[]) {
+    std::string rom_path;
+    uint64_t frames = 600;
+    bool unthrottled = false;
+    bool bench_cpu = false;
+    bool block_cache = false;
+    bool jit = false;
+    bool jit_lockstep = false;
+    std::vector<ScriptedPress> presses;
+    std::vector<WatchSpec> watches;
+    FaultPolicy fault_policy = FAULT_POLICY_HALT;
+    ScanlineCompositor::Path compositor = ScanlineCompositor::detect_path();
+    bool verify_compositor = false;
+    uint32_t render_interval = 1;
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc) {
+            rom_path = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--unthrottled") == 0) {
+            unthrottled = true;
+        } else if (strcmp(argv[i], "--bench-cpu") == 0) {
+            bench_cpu = true;
+            unthrottled = true;
+        } else if (strcmp(argv[i], "--block-cache") == 0) {
+            block_cache = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit = true;
+        } else if (strcmp(argv[i], "--jit-lockstep") == 0) {
+            jit = true;
+            jit_lockstep = true;
+        } else if (strcmp(argv[i], "--press") == 0 && i + 1 < argc) {
+            ScriptedPress press;
+            if (!parse_press(argv[++i], press)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            presses.push_back(press);
+        } else if ((strcmp(argv[i], "--watch") == 0 || strcmp(argv[i], "--break-on") == 0) && i + 1 < argc) {
+            WatchSpec watch;
+            bool pause = (strcmp(argv[i], "--break-on") == 0);
+            if (!parse_watch(argv[++i], pause, watch)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            watches.push_back(watch);
+        } else if (strcmp(argv[i], "--compositor") == 0 && i + 1 < argc) {
+            const char* path = argv[++i];
+            if (strcmp(path, "scalar") == 0) {
+                compositor = ScanlineCompositor::PATH_SCALAR;
+            } else if (strcmp(path, "sse2") == 0) {
+                compositor = ScanlineCompositor::PATH_SSE2;
+            } else if (strcmp(path, "avx2") == 0) {
+                compositor = ScanlineCompositor::PATH_AVX2;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--verify-compositor") == 0) {
+            verify_compositor = true;
+        } else if (strcmp(argv[i], "--render-every") == 0 && i + 1 < argc) {
+            render_interval = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--on-fault") == 0 && i + 1 < argc) {
+            const char* policy = argv[++i];
+            if (strcmp(policy, "halt") == 0) {
+                fault_policy = FAULT_POLICY_HALT;
+            } else if (strcmp(policy, "log") == 0) {
+                fault_policy = FAULT_POLICY_LOG;
+            } else if (strcmp(policy, "ignore") == 0) {
+                fault_policy = FAULT_POLICY_IGNORE;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (rom_path.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Watchpoints make the CPU interpret, and the lockstep memory comparison would trip them
+    if (!watches.empty() && (jit_lockstep || bench_cpu)) {
+        std::cerr << "[GameByte] --watch/--break-on can't be combined with --jit-lockstep or --bench-cpu" << std::endl;
+        return 1;
+    }
+
+    // The compositor check needs the PPU and a reference machine of its own
+    if (verify_compositor && (jit_lockstep || bench_cpu || !watches.empty())) {
+        std::cerr << "[GameByte] --verify-compositor can't be combined with --jit-lockstep, --bench-cpu or --watch/--break-on" << std::endl;
+        return 1;
+    }
+
+    // Skipped frames would leave nothing to compare
+    if (verify_compositor && render_interval != 1) {
+        std::cerr << "[GameByte] --verify-compositor can't be combined with --render-every" << std::endl;
+        return 1;
+    }
+
+    GameBoy gb;
+    if (!gb.load_rom(rom_path.c_str())) {
+        std::cerr << "[GameByte] Failed to load ROM: " << rom_path << std::endl;
+        return 1;
+    }
+
+    gb.cpu.set_block_cache_enabled(block_cache);
+    gb.cpu.fault_policy = fault_policy;
+    gb.ppu.set_render_interval(render_interval);
+    if (!gb.ppu.get_compositor().set_path(compositor)) {
+        std::cerr << "[GameByte] The " << ScanlineCompositor::get_path_name(compositor) << " compositor isn't supported on this host" << std::endl;
+        return 1;
+    }
+    queue_presses(gb, presses);
+
+    for (const WatchSpec& watch : watches) {
+        gb.mmu.add_watchpoint(watch.start, watch.end, watch.kinds, watch.pause);
+    }
+
+    // The lockstep reference runs the same blocks through the interpreter, so both machines step in the same units
+    GameBoy reference;
+    if (jit_lockstep) {
+        reference.load_rom(gb.mmu.get_rom());
+        reference.cpu.set_block_cache_enabled(true);
+        reference.cpu.fault_policy = fault_policy;
+        queue_presses(reference, presses);
+    } else if (verify_compositor) {
+        // Same machine, scalar compositor
+        reference.load_rom(gb.mmu.get_rom());
+        reference.cpu.set_block_cache_enabled(block_cache);
+        reference.cpu.fault_policy = fault_policy;
+        reference.ppu.get_compositor().set_path(ScanlineCompositor::PATH_SCALAR);
+        queue_presses(reference, presses);
+    }
+
+    if (jit) {
+        try {
+            gb.cpu.set_jit_enabled(true);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto frame_time = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / GameBoy::FRAMES_PER_SECOND));
+
+    uint64_t frames_run = 0;
+    uint64_t cycles_run = 0;
+    auto start_time = clock::now();
+    auto next_frame = start_time;
+
+    try {
+        while (frames_run < frames) {
+            if (jit_lockstep) {
+                cycles_run += run_lockstep_frame(gb, reference);
+            } else if (verify_compositor) {
+                cycles_run += run_compositor_frame(gb, reference, frames_run);
+            } else if (bench_cpu) {
+                cycles_run += run_cpu_frame(gb);
+            } else {
+                cycles_run += gb.run_frame();
+            }
+            frames_run++;
+
+            if (gb.is_fault_halted()) {
+                const Fault& fault = gb.get_fault();
+                std::cerr << "[GameByte] " << Fault::describe(fault.type) << " at 0x" << std::hex << std::uppercase
+                          << std::setw(4) << std::setfill('0') << fault.address << " (PC 0x" << std::setw(4) << fault.pc
+                          << ") in frame " << std::dec << std::nouppercase << frames_run << ", cycle " << fault.cycle << std::endl;
+                gb.cpu.dump_history();
+                return 1;
+            }
+
+            if (gb.cpu.watch_paused) {
+                std::cout << "[GameByte] Stopped at a watchpoint in frame " << frames_run << std::endl;
+                gb.cpu.dump_history();
+                break;
+            }
+
+            // Timing synchronization
+            if (!unthrottled) {
+                next_frame += frame_time;
+                std::this_thread::sleep_until(next_frame);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[GameByte] Emulation error after " << frames_run << " frames. Total cycles we got through: " << gb.cpu.total_cycles << std::endl;
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!watches.empty()) {
+        gb.cpu.dump_watch_hits();
+    }
+
+    double elapsed = std::chrono::duration<double>(clock::now() - start_time).count();
+    if (elapsed <= 0.0) elapsed = 1e-9;
+
+    std::cout << "[GameByte] Emulated " << frames_run << " frames (" << cycles_run << " cycles) in " << elapsed << " s" << std::endl;
+    std::cout << "[GameByte] " << (frames_run / elapsed) << " frames/sec, "
+              << (cycles_run / elapsed / 1e6) << " MHz effective ("
+              << (cycles_run / elapsed / GameBoy::CLOCK_HZ) << "x real time), "
+              << (gb.cpu.total_instructions / elapsed / 1e6) << " MIPS" << std::endl;
+
+    if (verify_compositor) {
+        std::cout << "[GameByte] " << ScanlineCompositor::get_path_name(compositor) << " compositor matched the scalar one in all "
+                  << frames_run << " frames" << std::endl;
+    }
+    return 0;
+}
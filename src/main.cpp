@@ -1,12 +1,12 @@
 #include <iostream>
+#include <cstdio>
 #include <SDL3/SDL.h>
 #include <string>
+#include <algorithm>
 
-#include "core/cpu.h"
-#include "core/mmu.h"
-#include "core/rom.h"
-#include "core/ppu.h"
-#include "core/joypad.h"
+#include "core/gameboy.h"
+#include "frontend/display.h"
+#include "frontend/input.h"
 
 // Structure to hold file dialog state
 struct DialogState {
@@ -25,24 +25,15 @@ void SDLCALL file_dialog_callback(void* userdata, const char* const* filelist, i
 }
 
 // Constants for timing
-const int CYCLES_PER_FRAME = 70224;
-// 4194304 Hz / 70224 cycles/frame = 59.7275 Hz
-const double FRAME_TIME_MS = 1000.0 / 59.7275; 
+const double FRAME_TIME_MS = 1000.0 / GameBoy::FRAMES_PER_SECOND; 
+
+// Frames the PPU may leave undrawn in a row while the emulator is behind real time, so the screen still updates
+const int MAX_FRAME_SKIP = 4;
 
 int main(int argc, char* argv[]) {
     // Base components and connections
-    MMU mmu;
-    CPU cpu;
-    PPU ppu;
-    ROM rom;
-    Joypad joypad;
-
-    ppu.connect_mmu(&mmu);
-    mmu.connect_ppu(&ppu);
-    cpu.connect_mmu(&mmu);
-    mmu.connect_cpu(&cpu);
-    mmu.connect_joypad(&joypad);
-    mmu.connect_rom(&rom);
+    GameBoy gb;
+    Display display;
 
     // Initialization
     std::cout << "[GameByte] Initializing GameByte..." << std::endl;
@@ -53,8 +44,11 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Initialize PPU SDL components
-    ppu.init_sdl();
+    // Initialize display SDL components
+    if (!display.init()) {
+        std::cerr << "[SDL] Failed to create window - SDL_Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
 
     bool running = true;
     SDL_Event e;
@@ -83,11 +77,9 @@ int main(int argc, char* argv[]) {
     }
 
     // Attempt to load ROM from path
-    if (ROM::load(dialog_state.selected_path.c_str())) {
-        mmu.load_game(ROM::data, ROM::size);
-
+    if (gb.load_rom(dialog_state.selected_path.c_str())) {
         // Handle battery backup save loading
-        if (ROM::data[ROM::OFFSET_TYPE] == ROM::ROM_MBC1_RAM_BATT) {
+        if (ROM::has_battery(gb.mmu.get_rom()->get_type())) {
             std::string save_path = dialog_state.selected_path;
             
             size_t lastindex = save_path.find_last_of("."); 
@@ -95,7 +87,7 @@ int main(int argc, char* argv[]) {
                 save_path = save_path.substr(0, lastindex); 
             }
             save_path += ".sav";
-            mmu.load_save(save_path.c_str());
+            gb.load_save(save_path.c_str());
         }
 
     } else {
@@ -106,6 +98,7 @@ int main(int argc, char* argv[]) {
 
     // Main emulation loop
     uint32_t frame_count = 0;
+    int frames_skipped = 0;
     while (running) {
         frame_count++;
 
@@ -119,59 +112,47 @@ int main(int argc, char* argv[]) {
         int cycles_since_last_poll = 0;
 
         // Run CPU for one frame
-        try {
-            while (cycles_this_frame < CYCLES_PER_FRAME) {
-                int cycles = cpu.step();
-                cycles_this_frame += cycles;
-                cycles_since_last_poll += cycles;
-                
-                cpu.tick_timers(cycles);
-                ppu.tick(cycles);
-
-                // Poll for input every scanline (~456 cycles)
-                if (cycles_since_last_poll >= 456) {
-                    while (SDL_PollEvent(&e) != 0) {
-                        // Handle quit event
-                        if (e.type == SDL_EVENT_QUIT) {
-                            running = false;
-                            
-                            // Save game data on exit if applicable
-                            if (rom.data && rom.data[ROM::OFFSET_TYPE] == ROM::ROM_MBC1_RAM_BATT) {
-                                std::string save_path = dialog_state.selected_path;
-                                size_t lastindex = save_path.find_last_of("."); 
-                                if (lastindex != std::string::npos) {
-                                    save_path = save_path.substr(0, lastindex); 
-                                }
-                                save_path += ".sav";
-                                mmu.save_game(save_path.c_str());
-                            }
-                        }
-
-                        // Input handoff from SDL to Joypad
-                        if (joypad.handle_sdl_event(e)) {
-                            // Request Joypad Interrupt (bit 4 of IF register)
-                            uint8_t if_reg = mmu.read_byte(0xFF0F);
-                            mmu.write_byte(0xFF0F, if_reg | 0x10);
-                        }
+        while (cycles_this_frame < GameBoy::CYCLES_PER_FRAME && !gb.is_fault_halted()) {
+            // Halts and idle loops are skipped in one go, but never past the next input poll
+            int cycles = gb.advance(std::min(GameBoy::CYCLES_PER_FRAME - cycles_this_frame, 456 - cycles_since_last_poll));
+            cycles_this_frame += cycles;
+            cycles_since_last_poll += cycles;
+
+            // Poll for input every scanline (~456 cycles)
+            if (cycles_since_last_poll >= 456) {
+                while (SDL_PollEvent(&e) != 0) {
+                    // Handle quit event
+                    if (e.type == SDL_EVENT_QUIT) {
+                        running = false;
                     }
-                    cycles_since_last_poll = 0;
+
+                    // Input handoff from SDL to Joypad
+                    handle_sdl_input_event(gb, e);
                 }
+                cycles_since_last_poll = 0;
+            }
 
-                // Check if frame is ready to be drawn
-                if (ppu.get_ly() == 144) {
-                    if (!frame_drawn_this_vblank) {
-                        ppu.render_frame();
-                        frame_drawn_this_vblank = true;
-                    }
-                } else if (ppu.get_ly() != 144) {
-                    // Only allow a new draw once the PPU leaves the V-Blank trigger line
-                    frame_drawn_this_vblank = false;
+            // Check if frame is ready to be drawn
+            if (gb.ppu.get_ly() == 144) {
+                // A skipped frame leaves the last one on screen
+                if (!frame_drawn_this_vblank && gb.ppu.is_frame_rendered()) {
+                    display.render_frame(gb.ppu.get_framebuffer());
+                    frame_drawn_this_vblank = true;
                 }
+            } else if (gb.ppu.get_ly() != 144) {
+                // Only allow a new draw once the PPU leaves the V-Blank trigger line
+                frame_drawn_this_vblank = false;
             }
-        } catch (const std::exception& e) {
-            std::cerr << "[GameByte] Emulation error about to occur. Total cycles we got through: " << cpu.total_cycles << std::endl;
-            std::cerr << e.what() << std::endl;
-            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "GameByte - Execution Error", e.what(), nullptr);
+        }
+
+        // The ROM did something the hardware has no answer to - FAULT_POLICY_HALT stopped the machine
+        if (gb.is_fault_halted()) {
+            const Fault& fault = gb.get_fault();
+            char message[128];
+            snprintf(message, sizeof(message), "%s at 0x%04X (PC 0x%04X)", Fault::describe(fault.type), fault.address, fault.pc);
+            std::cerr << "[GameByte] Emulation error. Total cycles we got through: " << gb.cpu.total_cycles << std::endl;
+            std::cerr << message << std::endl;
+            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "GameByte - Execution Error", message, nullptr);
             running = false; // Stop on error
             return 1;
         }
@@ -179,19 +160,19 @@ int main(int argc, char* argv[]) {
         // Debug keys
         const bool* keys = SDL_GetKeyboardState(NULL);
         if (keys[SDL_SCANCODE_F1]) {
-            mmu.dump_vram();
+            gb.mmu.dump_vram();
         }
 
         if (keys[SDL_SCANCODE_F2]) {
-            mmu.dump_hram();
+            gb.mmu.dump_hram();
         }
 
         if (keys[SDL_SCANCODE_F3]) {
-            cpu.debug_interrupt_status();
+            gb.cpu.debug_interrupt_status();
         }
 
         if (keys[SDL_SCANCODE_F4]) {
-            cpu.dump_history();
+            gb.cpu.dump_history();
         }
 
         // Timing synchronization
@@ -201,6 +182,13 @@ int main(int argc, char* argv[]) {
         if (elapsed_ms < FRAME_TIME_MS) {
             // Sleep for the remaining time
             SDL_Delay(static_cast<uint32_t>(FRAME_TIME_MS - elapsed_ms));
+            frames_skipped = 0;
+        } else if (frames_skipped < MAX_FRAME_SKIP) {
+            // Fell behind - save the next frame's drawing and presenting
+            gb.ppu.skip_frame();
+            frames_skipped++;
+        } else {
+            frames_skipped = 0;
         }
     }
 
@@ -0,0 +1,256 @@
+import os
+import sys
+
+# Builds compositor.gb, the ROM the compositor regression test runs through `gamebyte-headless --verify-compositor`.
+# It only exists to put as many different lines through the scanline compositor as possible:
+#   - 16 tiles with every color index, on a scrolling background and a window that slides in from the right
+#   - 40 sprites drifting across both screen edges, cycling through OBP0/OBP1, flips and background priority
+#   - BGP, OBP0 and OBP1 from a table every frame, and another BGP from line 72 on
+#   - LCDC cycling through 8x16 sprites, the window and background on/off every 16 frames
+# Regenerate with: python tests/roms/make_compositor_rom.py tests/roms/compositor.gb
+
+ROM_SIZE = 0x8000
+
+VBLANK_HANDLER = 0x0200
+STAT_HANDLER = 0x0280
+COPY_ROUTINE = 0x02C0
+MAIN = 0x0150
+
+BG_MAP = 0x1000
+WINDOW_MAP = 0x1400
+TILES = 0x1800
+OAM_DATA = 0x1900
+BGP_TABLE = 0x3000
+OBP0_TABLE = 0x3040
+OBP1_TABLE = 0x3080
+MID_BGP_TABLE = 0x30C0
+LCDC_TABLE = 0x3100
+
+FRAME_COUNTER = 0xC000
+OAM_SHADOW = 0xC100
+DMA_ROUTINE = 0xFF80
+
+
+class Assembler:
+    """Just enough of an SM83 assembler for this ROM - raw opcodes plus labels for JR/JP/CALL."""
+
+    def __init__(self, origin):
+        self.origin = origin
+        self.code = bytearray()
+        self.labels = {}
+        self.fixups = []
+
+    def here(self):
+        return self.origin + len(self.code)
+
+    def label(self, name):
+        self.labels[name] = self.here()
+
+    def emit(self, *values):
+        self.code += bytes(values)
+
+    def jr(self, opcode, name):
+        self.emit(opcode, 0)
+        self.fixups.append(('relative', len(self.code) - 1, name))
+
+    def jp(self, opcode, name):
+        self.emit(opcode, 0, 0)
+        self.fixups.append(('absolute', len(self.code) - 2, name))
+
+    def assemble(self):
+        for kind, offset, name in self.fixups:
+            target = self.labels[name]
+            if kind == 'relative':
+                distance = target - (self.origin + offset + 1)
+                assert -128 <= distance < 128, f"JR to {name} out of range"
+                self.code[offset] = distance & 0xFF
+            else:
+                self.code[offset] = target & 0xFF
+                self.code[offset + 1] = target >> 8
+        return self.code
+
+
+def lcg(seed):
+    # Fixed pseudo-random sequence, so the ROM comes out byte-identical everywhere
+    state = seed
+    while True:
+        state = (state * 1103515245 + 12345) & 0x7FFFFFFF
+        yield state >> 16
+
+
+def build_data(rom):
+    numbers = lcg(0x1D)
+
+    # Every tile row mixes all four color indices somewhere across the 16 tiles
+    for tile in range(16):
+        for row in range(8):
+            base = TILES + tile * 16 + row * 2
+            rom[base] = next(numbers) & 0xFF
+            rom[base + 1] = next(numbers) & 0xFF
+
+    for i in range(32 * 32):
+        x, y = i % 32, i // 32
+        rom[BG_MAP + i] = (x + y) & 0x0F
+        rom[WINDOW_MAP + i] = (x * 3 + y * 5) & 0x0F
+
+    # Sprites start spread over the whole OAM coordinate range, so some are always partly off screen
+    for sprite in range(40):
+        base = OAM_DATA + sprite * 4
+        rom[base] = (sprite * 13) % 176
+        rom[base + 1] = (sprite * 23) % 176
+        rom[base + 2] = sprite & 0x0F
+        # Bit 7: behind the background, bit 6: Y flip, bit 5: X flip, bit 4: OBP1
+        rom[base + 3] = ((sprite & 1) << 7) | ((sprite & 8) << 3) | ((sprite & 4) << 3) | ((sprite & 2) << 3)
+
+    for table in (BGP_TABLE, OBP0_TABLE, OBP1_TABLE, MID_BGP_TABLE):
+        for i in range(64):
+            rom[table + i] = next(numbers) & 0xFF
+
+    # LCD on with tile data at $8000 in every entry; bit 0 background, bit 1 sprites, bit 2 8x16 sprites,
+    # bit 3 background map $9C00, bit 5 window, bit 6 window map $9C00
+    for i in range(16):
+        rom[LCDC_TABLE + i] = (0x90 | 0x02 | ((i & 1) << 2) | ((i & 2) << 4) | (0x01 if i % 3 else 0x00) |
+                               (0x40 if i & 4 else 0x00) | (0x08 if i & 8 else 0x00))
+
+
+def build_code(rom):
+    # Vectors: V-Blank and LCD STAT, then the entry point
+    rom[0x0040:0x0043] = bytes([0xC3, VBLANK_HANDLER & 0xFF, VBLANK_HANDLER >> 8])
+    rom[0x0048:0x004B] = bytes([0xC3, STAT_HANDLER & 0xFF, STAT_HANDLER >> 8])
+    rom[0x0100:0x0104] = bytes([0x00, 0xC3, MAIN & 0xFF, MAIN >> 8])
+
+    # copy: BC bytes from DE to HL
+    copy = Assembler(COPY_ROUTINE)
+    copy.label('loop')
+    copy.emit(0x1A, 0x22, 0x13, 0x0B)           # LD A,(DE) ; LD (HL+),A ; INC DE ; DEC BC
+    copy.emit(0x78, 0xB1)                       # LD A,B ; OR C
+    copy.jr(0x20, 'loop')                       # JR NZ,loop
+    copy.emit(0xC9)                             # RET
+
+    def call_copy(asm, destination, source, length):
+        asm.emit(0x21, destination & 0xFF, destination >> 8)
+        asm.emit(0x11, source & 0xFF, source >> 8)
+        asm.emit(0x01, length & 0xFF, length >> 8)
+        asm.emit(0xCD, COPY_ROUTINE & 0xFF, COPY_ROUTINE >> 8)
+
+    def load_table(asm, table, port):
+        # A = table[frame counter & 63], then written to the I/O port
+        asm.emit(0xFA, FRAME_COUNTER & 0xFF, FRAME_COUNTER >> 8)  # LD A,(frame)
+        asm.emit(0xE6, 0x3F, 0x6F)                                # AND $3F ; LD L,A
+        asm.emit(0x26, table >> 8)                                # LD H,table high
+        asm.emit(0x7D, 0xC6, table & 0xFF, 0x6F)                  # LD A,L ; ADD table low ; LD L,A
+        asm.emit(0x7E, 0xE0, port)                                # LD A,(HL) ; LDH (port),A
+
+    main = Assembler(MAIN)
+    main.emit(0xF3, 0x31, 0xFE, 0xFF)           # DI ; LD SP,$FFFE
+
+    # VRAM is only free with the LCD off, which may only happen during V-Blank
+    main.label('wait_vblank')
+    main.emit(0xF0, 0x44, 0xFE, 0x90)           # LDH A,(LY) ; CP 144
+    main.jr(0x38, 'wait_vblank')                # JR C,wait_vblank
+    main.emit(0xAF, 0xE0, 0x40)                 # XOR A ; LDH (LCDC),A
+
+    call_copy(main, 0x8000, TILES, 16 * 16)
+    call_copy(main, 0x9800, BG_MAP, 32 * 32)
+    call_copy(main, 0x9C00, WINDOW_MAP, 32 * 32)
+    call_copy(main, OAM_SHADOW, OAM_DATA, 40 * 4)
+
+    # OAM DMA routine in HRAM: LD A,$C1 ; LDH (DMA),A ; LD A,40 ; wait: DEC A ; JR NZ,wait ; RET
+    dma = [0x3E, OAM_SHADOW >> 8, 0xE0, 0x46, 0x3E, 40, 0x3D, 0x20, 0xFD, 0xC9]
+    main.emit(0x21, DMA_ROUTINE & 0xFF, DMA_ROUTINE >> 8)
+    for value in dma:
+        main.emit(0x36, value, 0x23)            # LD (HL),value ; INC HL
+    main.emit(0xCD, DMA_ROUTINE & 0xFF, DMA_ROUTINE >> 8)
+
+    main.emit(0xAF, 0xEA, FRAME_COUNTER & 0xFF, FRAME_COUNTER >> 8)  # XOR A ; LD (frame),A
+    main.emit(0x3E, 0xE4, 0xE0, 0x47)           # BGP
+    main.emit(0x3E, 0xD2, 0xE0, 0x48)           # OBP0
+    main.emit(0x3E, 0x1B, 0xE0, 0x49)           # OBP1
+    main.emit(0x3E, 0x20, 0xE0, 0x4A)           # WY
+    main.emit(0x3E, 0x57, 0xE0, 0x4B)           # WX
+    main.emit(0x3E, 72, 0xE0, 0x45)             # LYC
+    main.emit(0x3E, 0x40, 0xE0, 0x41)           # STAT: LYC interrupt
+    main.emit(0x3E, 0x93, 0xE0, 0x40)           # LCDC: LCD, background and sprites on
+    main.emit(0x3E, 0x03, 0xE0, 0xFF)           # IE: V-Blank and LCD STAT
+    main.emit(0xAF, 0xE0, 0x0F, 0xFB)           # XOR A ; LDH (IF),A ; EI
+
+    main.label('idle')
+    main.emit(0x76, 0x00)                       # HALT ; NOP
+    main.jr(0x18, 'idle')                       # JR idle
+
+    vblank = Assembler(VBLANK_HANDLER)
+    vblank.emit(0xF5, 0xE5, 0xC5)               # PUSH AF ; PUSH HL ; PUSH BC
+    vblank.emit(0xCD, DMA_ROUTINE & 0xFF, DMA_ROUTINE >> 8)
+
+    vblank.emit(0x21, FRAME_COUNTER & 0xFF, FRAME_COUNTER >> 8, 0x34)  # LD HL,frame ; INC (HL)
+    load_table(vblank, BGP_TABLE, 0x47)
+    load_table(vblank, OBP0_TABLE, 0x48)
+    load_table(vblank, OBP1_TABLE, 0x49)
+
+    # LCDC from the frame counter's upper nibble
+    vblank.emit(0xFA, FRAME_COUNTER & 0xFF, FRAME_COUNTER >> 8)  # LD A,(frame)
+    vblank.emit(0xCB, 0x37, 0xE6, 0x0F)         # SWAP A ; AND $0F
+    vblank.emit(0x6F, 0x26, LCDC_TABLE >> 8)    # LD L,A ; LD H,table high
+    vblank.emit(0x7E, 0xE0, 0x40)               # LD A,(HL) ; LDH (LCDC),A
+
+    # Scroll the background diagonally, slide the window and move WY
+    vblank.emit(0xF0, 0x43, 0x3C, 0xE0, 0x43)   # SCX += 1
+    vblank.emit(0xF0, 0x42, 0xC6, 0x03, 0xE0, 0x42)  # SCY += 3
+    vblank.emit(0xF0, 0x4B, 0xC6, 0x05)         # LDH A,(WX) ; ADD 5
+    vblank.emit(0xFE, 167)                      # CP 167
+    vblank.jr(0x38, 'wx_ok')                    # JR C,wx_ok
+    vblank.emit(0xD6, 160)                      # SUB 160
+    vblank.label('wx_ok')
+    vblank.emit(0xE0, 0x4B)                     # LDH (WX),A
+    vblank.emit(0xFA, FRAME_COUNTER & 0xFF, FRAME_COUNTER >> 8, 0xE6, 0x7F, 0xE0, 0x4A)  # WY = frame & $7F
+
+    # Every sprite moves down one line and right two pixels
+    vblank.emit(0x21, OAM_SHADOW & 0xFF, OAM_SHADOW >> 8, 0x06, 40)  # LD HL,shadow ; LD B,40
+    vblank.label('sprites')
+    vblank.emit(0x34, 0x23, 0x34, 0x34, 0x23, 0x23, 0x23)  # INC (HL) ; INC HL ; INC (HL) ; INC (HL) ; INC HL x3
+    vblank.emit(0x05)                           # DEC B
+    vblank.jr(0x20, 'sprites')                  # JR NZ,sprites
+
+    vblank.emit(0xC1, 0xE1, 0xF1, 0xD9)         # POP BC ; POP HL ; POP AF ; RETI
+
+    # LYC: a second background palette for the lower half of the screen
+    stat = Assembler(STAT_HANDLER)
+    stat.emit(0xF5, 0xE5)                       # PUSH AF ; PUSH HL
+    load_table(stat, MID_BGP_TABLE, 0x47)
+    stat.emit(0xE1, 0xF1, 0xD9)                 # POP HL ; POP AF ; RETI
+
+    for asm in (copy, main, vblank, stat):
+        code = asm.assemble()
+        rom[asm.origin:asm.origin + len(code)] = code
+
+    assert MAIN + len(main.code) <= VBLANK_HANDLER
+    assert VBLANK_HANDLER + len(vblank.code) <= STAT_HANDLER
+    assert STAT_HANDLER + len(stat.code) <= COPY_ROUTINE
+
+
+def build_rom():
+    rom = bytearray(ROM_SIZE)
+
+    # Header: title, ROM only, 32 KB, no RAM
+    title = b'COMPOSITOR TEST'
+    rom[0x0134:0x0134 + len(title)] = title
+    rom[0x0147] = 0x00
+    rom[0x0148] = 0x00
+    rom[0x0149] = 0x00
+
+    build_data(rom)
+    build_code(rom)
+
+    checksum = 0
+    for value in rom[0x0134:0x014D]:
+        checksum = (checksum - value - 1) & 0xFF
+    rom[0x014D] = checksum
+
+    return rom
+
+
+if __name__ == "__main__":
+    output = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), 'compositor.gb')
+    with open(output, 'wb') as f:
+        f.write(build_rom())
+    print(f"Wrote {output}")